@@ -0,0 +1,50 @@
+#include "arena.hpp"
+
+#include <cstdint>
+
+namespace gerben {
+
+inline std::byte* AlignUp(std::byte* p, size_t alignment) {
+    auto x = reinterpret_cast<uintptr_t>(p);
+    return p + (-x & (alignment - 1));
+}
+
+void Arena::Release() noexcept {
+    while (blocks_) {
+        auto prev = blocks_->prev;
+        upstream_->deallocate(blocks_, blocks_->size, alignof(Block));
+        blocks_ = prev;
+    }
+    ptr_ = end_ = last_ = nullptr;
+}
+
+void* Arena::do_allocate(size_t bytes, size_t alignment) {
+    auto p = AlignUp(ptr_, alignment);
+    if (ptr_ == nullptr || p > end_ || bytes > static_cast<size_t>(end_ - p)) {
+        auto size = std::max(block_size_, sizeof(Block) + bytes + alignment);
+        auto block = static_cast<Block*>(upstream_->allocate(size, alignof(Block)));
+        block->prev = blocks_;
+        block->size = size;
+        blocks_ = block;
+        end_ = reinterpret_cast<std::byte*>(block) + size;
+        p = AlignUp(reinterpret_cast<std::byte*>(block + 1), alignment);
+    }
+    ptr_ = p + bytes;
+    last_ = p;
+    return p;
+}
+
+void Arena::do_deallocate(void* p, size_t bytes, size_t) {
+    if (IsLast(p, bytes)) {
+        ptr_ = last_;
+        last_ = nullptr;
+    }
+}
+
+bool Arena::do_try_expand(void* p, size_t old_bytes, size_t new_bytes, size_t) {
+    if (!IsLast(p, old_bytes) || new_bytes > static_cast<size_t>(end_ - last_)) return false;
+    ptr_ = last_ + new_bytes;
+    return true;
+}
+
+}  // namespace gerben
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstddef>
+
+#include "vector.hpp"
+
+namespace gerben {
+
+// Bump allocator for vectors that die together, e.g. everything built while handling a request.
+// Deallocating is free and only reclaims memory when it's the most recent allocation, which is
+// also the one that GrowOutline can extend in place. Blocks go back upstream on Release or
+// destruction. Not thread safe.
+class Arena : public MemResource {
+public:
+    explicit Arena(size_t block_size = 4096, MemResource* upstream = DefaultResource()) noexcept
+        : block_size_(block_size), upstream_(upstream) {}
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+    ~Arena() noexcept override { Release(); }
+
+    // Returns all blocks upstream, everything allocated from the arena is invalidated.
+    void Release() noexcept;
+
+private:
+    struct alignas(std::max_align_t) Block {
+        Block* prev;
+        size_t size;
+    };
+
+    void* do_allocate(size_t bytes, size_t alignment) override;
+    void do_deallocate(void* p, size_t bytes, size_t alignment) override;
+    bool do_try_expand(void* p, size_t old_bytes, size_t new_bytes, size_t alignment) override;
+    bool do_is_equal(std::pmr::memory_resource const& other) const noexcept override {
+        return this == &other;
+    }
+
+    bool IsLast(void* p, size_t bytes) const noexcept {
+        return static_cast<std::byte*>(p) + bytes == ptr_ && p == last_;
+    }
+
+    // Free space of the current block is [ptr_, end_), last_ is the most recent allocation.
+    std::byte* ptr_ = nullptr;
+    std::byte* end_ = nullptr;
+    std::byte* last_ = nullptr;
+    Block* blocks_ = nullptr;
+    size_t block_size_;
+    MemResource* upstream_;
+};
+
+}  // namespace gerben
@@ -1,7 +1,21 @@
 #include "vector.hpp"
+#include "arena.hpp"
+#include "pool.hpp"
+#include "simd.hpp"
+#include "concurrent_vec.hpp"
+#include "seg_vec.hpp"
+#include "incremental_vec.hpp"
+#include "soa_vec.hpp"
+#include "vec_builder.hpp"
+#include "numa.hpp"
 
+#include <chrono>
+#include <mutex>
+#include <string>
 #include <vector>
 
+#include <sched.h>
+
 #include "benchmark/benchmark.h"
 #include "google/protobuf/repeated_field.h"
 
@@ -32,6 +46,33 @@ void AddLocalCapture(int n, T* x) {
     for (int i = 0; i < n; i++) y.push_back(i);
 }
 
+template <typename T>
+__attribute__((noinline))
+void AddBuilder(int n, T* x) {
+    gerben::VecBuilder y(x);
+    for (int i = 0; i < n; i++) y.push_back(i);
+}
+
+template <typename T>
+__attribute__((noinline))
+void AddReserved(int n, T* x) {
+    auto w = x->back_inserter_reserved(n);
+    for (int i = 0; i < n; i++) w.push_back(i);
+}
+
+template <typename T>
+__attribute__((noinline))
+void Emplace(int n, T* x) {
+    for (int i = 0; i < n; i++) x->emplace_back(8, 'a' + (i & 15));
+}
+
+template <typename T>
+__attribute__((noinline))
+void EmplaceBuilder(int n, T* x) {
+    gerben::VecBuilder y(x);
+    for (int i = 0; i < n; i++) y.emplace_back(8, 'a' + (i & 15));
+}
+
 template <typename T>
 __attribute__((noinline))
 void PopPush(T* from, T* to) {
@@ -56,7 +97,9 @@ void PopPushLocalCapture(T* x, T* y) {
 
 enum LocalCapture {
     kNoCapture,
-    kLocalCapture
+    kLocalCapture,
+    // gerben::VecBuilder, only for gerben::Vec.
+    kBuilder
 };
 
 auto dummy = []() {
@@ -86,8 +129,10 @@ template <typename T, LocalCapture capture>
 void BM_PushBack(benchmark::State& state) {
     T x;
     for (auto _ : state) {
-        if (capture == kLocalCapture) {
+        if constexpr (capture == kLocalCapture) {
             AddLocalCapture(10000, &x);
+        } else if constexpr (capture == kBuilder) {
+            AddBuilder(10000, &x);
         } else {
             Add(10000, &x);
         }
@@ -102,6 +147,37 @@ BENCHMARK_TEMPLATE(BM_PushBack, ProtoVec<int>, kNoCapture);
 BENCHMARK_TEMPLATE(BM_PushBack, gerben::Vec<int>, kLocalCapture);
 BENCHMARK_TEMPLATE(BM_PushBack, std::vector<int>, kLocalCapture);
 BENCHMARK_TEMPLATE(BM_PushBack, ProtoVec<int>, kLocalCapture);
+BENCHMARK_TEMPLATE(BM_PushBack, gerben::Vec<int>, kBuilder);
+
+// The same loop through AppendWriter, which checks capacity once per call instead of per element.
+void BM_PushBackReserved(benchmark::State& state) {
+    gerben::Vec<int> x;
+    for (auto _ : state) {
+        AddReserved(10000, &x);
+        x.clear();
+        benchmark::DoNotOptimize(x.data());
+    }
+}
+
+BENCHMARK(BM_PushBackReserved);
+
+template <typename T, LocalCapture capture = kNoCapture>
+void BM_EmplaceBack(benchmark::State& state) {
+    T x;
+    for (auto _ : state) {
+        if constexpr (capture == kBuilder) {
+            EmplaceBuilder(10000, &x);
+        } else {
+            Emplace(10000, &x);
+        }
+        x.clear();
+        benchmark::DoNotOptimize(x.data());
+    }
+}
+
+BENCHMARK_TEMPLATE(BM_EmplaceBack, gerben::Vec<std::string>);
+BENCHMARK_TEMPLATE(BM_EmplaceBack, std::vector<std::string>);
+BENCHMARK_TEMPLATE(BM_EmplaceBack, gerben::Vec<std::string>, kBuilder);
 
 template <typename T, LocalCapture capture>
 void BM_PopPush(benchmark::State& state) {
@@ -125,3 +201,176 @@ BENCHMARK_TEMPLATE(BM_PopPush, ProtoVec<int>, kNoCapture);
 BENCHMARK_TEMPLATE(BM_PopPush, gerben::Vec<int>, kLocalCapture);
 BENCHMARK_TEMPLATE(BM_PopPush, std::vector<int>, kLocalCapture);
 BENCHMARK_TEMPLATE(BM_PopPush, ProtoVec<int>, kLocalCapture);
+
+enum EraseKind { kStdEraseIf, kMemberEraseIf, kSimdEraseIf };
+
+template <typename T, EraseKind kind>
+void BM_EraseIf(benchmark::State& state) {
+    T x;
+    for (auto _ : state) {
+        for (int i = 0; i < 10000; i++) x.push_back(i * 7919 % 10007);
+        if constexpr (kind == kStdEraseIf) {
+            std::erase_if(x, [](int v) { return v < 5000; });
+        } else if constexpr (kind == kMemberEraseIf) {
+            x.erase_if([](int v) { return v < 5000; });
+        } else {
+            x.erase_if(gerben::simd::Compare<int>{gerben::simd::Cmp::kLt, 5000});
+        }
+        benchmark::DoNotOptimize(x.data());
+        x.clear();
+    }
+}
+
+BENCHMARK_TEMPLATE(BM_EraseIf, std::vector<int>, kStdEraseIf);
+BENCHMARK_TEMPLATE(BM_EraseIf, gerben::Vec<int>, kMemberEraseIf);
+BENCHMARK_TEMPLATE(BM_EraseIf, gerben::Vec<int>, kSimdEraseIf);
+
+template <bool use_arena>
+void BM_ManySmallVecs(benchmark::State& state) {
+    for (auto _ : state) {
+        gerben::Arena arena;
+        for (int i = 0; i < 100; i++) {
+            auto v = use_arena ? gerben::Vec<int>(&arena) : gerben::Vec<int>();
+            Add(10, &v);
+            benchmark::DoNotOptimize(v.data());
+        }
+    }
+}
+
+BENCHMARK_TEMPLATE(BM_ManySmallVecs, false);
+BENCHMARK_TEMPLATE(BM_ManySmallVecs, true);
+
+template <bool use_pool>
+void BM_GrowThreaded(benchmark::State& state) {
+    for (auto _ : state) {
+        auto v = use_pool ? gerben::Vec<int>(gerben::PoolResource()) : gerben::Vec<int>();
+        Add(1000, &v);
+        benchmark::DoNotOptimize(v.data());
+    }
+}
+
+BENCHMARK_TEMPLATE(BM_GrowThreaded, false)->ThreadRange(1, 64);
+BENCHMARK_TEMPLATE(BM_GrowThreaded, true)->ThreadRange(1, 64);
+
+template <bool concurrent>
+void BM_SharedIngest(benchmark::State& state) {
+    static gerben::ConcurrentVec<int>* cvec;
+    static gerben::Vec<int>* vec;
+    static std::mutex mu;
+    if (state.thread_index() == 0) {
+        cvec = new gerben::ConcurrentVec<int>;
+        vec = new gerben::Vec<int>;
+    }
+    for (auto _ : state) {
+        for (int i = 0; i < 256; i++) {
+            if constexpr (concurrent) {
+                cvec->push_back(i);
+            } else {
+                std::lock_guard lock(mu);
+                vec->push_back(i);
+            }
+        }
+    }
+    if (state.thread_index() == 0) {
+        delete cvec;
+        delete vec;
+    }
+}
+
+BENCHMARK_TEMPLATE(BM_SharedIngest, false)->Iterations(2000)->ThreadRange(1, 64);
+BENCHMARK_TEMPLATE(BM_SharedIngest, true)->Iterations(2000)->ThreadRange(1, 64);
+
+// Reports the slowest single push_back, the doubling copy of a Vec shows up there. Uses a type
+// that isn't relocatable with libstdc++, ints would let realloc move the pages instead.
+template <typename T>
+void BM_WorstCaseAppend(benchmark::State& state) {
+    double worst_ns = 0;
+    for (auto _ : state) {
+        T x;
+        for (int i = 0; i < (1 << 20); i++) {
+            auto start = std::chrono::steady_clock::now();
+            x.push_back(std::string());
+            auto ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+            worst_ns = std::max(worst_ns, ns);
+        }
+        benchmark::DoNotOptimize(&x[0]);
+    }
+    state.counters["max_ns"] = worst_ns;
+}
+
+BENCHMARK_TEMPLATE(BM_WorstCaseAppend, gerben::Vec<std::string>);
+BENCHMARK_TEMPLATE(BM_WorstCaseAppend, gerben::SegVec<std::string>);
+BENCHMARK_TEMPLATE(BM_WorstCaseAppend, gerben::IncrementalVec<std::string>);
+
+struct Particle {
+    float x, y, z;
+    uint32_t id;
+};
+
+// Sums one field of 1M particles, the row layout drags the other three through the cache.
+template <bool soa>
+void BM_ScanField(benchmark::State& state) {
+    std::conditional_t<soa, gerben::SoAVec<float, float, float, uint32_t>, gerben::Vec<Particle>> x;
+    for (int i = 0; i < (1 << 20); i++) x.push_back({i * 0.5f, i * 0.25f, 1.0f, uint32_t(i)});
+    for (auto _ : state) {
+        float sum = 0;
+        if constexpr (soa) {
+            for (float v : x.template column<0>()) sum += v;
+        } else {
+            for (auto& p : x) sum += p.x;
+        }
+        benchmark::DoNotOptimize(sum);
+    }
+}
+
+BENCHMARK_TEMPLATE(BM_ScanField, false);
+BENCHMARK_TEMPLATE(BM_ScanField, true);
+
+enum NumaPlacement {
+    kLocalNode,
+    kRemoteNode,
+    kInterleavedNodes,
+};
+
+// Scan bandwidth of 256 MiB filled by this thread, with the pages on its node, on the next online
+// node or spread over all of them. The thread is pinned to its CPU for the run so local stays
+// local. Errors out if the policy didn't take, rather than measuring first touch placement.
+template <NumaPlacement placement>
+void BM_ScanNuma(benchmark::State& state) {
+    auto nodes = gerben::OnlineNumaNodes();
+    if (placement == kRemoteNode && nodes.size() < 2) {
+        state.SkipWithError("needs two NUMA nodes");
+        return;
+    }
+    cpu_set_t saved, pinned;
+    sched_getaffinity(0, sizeof(saved), &saved);
+    CPU_ZERO(&pinned);
+    CPU_SET(sched_getcpu(), &pinned);
+    sched_setaffinity(0, sizeof(pinned), &pinned);
+
+    auto local = gerben::CurrentNumaNode();
+    // Node ids can have gaps, so the remote node is the one after local in the online list.
+    auto next = std::upper_bound(nodes.begin(), nodes.end(), local);
+    auto remote = next == nodes.end() ? nodes[0] : *next;
+    gerben::NumaResource mr(placement == kLocalNode    ? local
+                            : placement == kRemoteNode ? remote
+                                                       : gerben::NumaResource::kInterleaved);
+    gerben::Vec<uint64_t> x(&mr);
+    // Grows through GrowOutline like any other vector, every buffer comes from mr.
+    for (uint64_t i = 0; i < (uint64_t{1} << 25); i++) x.push_back(i);
+    if (!mr.placed()) {
+        state.SkipWithError("mbind failed");
+    } else {
+        for (auto _ : state) {
+            uint64_t sum = 0;
+            for (auto v : x) sum += v;
+            benchmark::DoNotOptimize(sum);
+        }
+        state.SetBytesProcessed(state.iterations() * x.size() * sizeof(uint64_t));
+    }
+    sched_setaffinity(0, sizeof(saved), &saved);
+}
+
+BENCHMARK_TEMPLATE(BM_ScanNuma, kLocalNode);
+BENCHMARK_TEMPLATE(BM_ScanNuma, kRemoteNode);
+BENCHMARK_TEMPLATE(BM_ScanNuma, kInterleavedNodes);
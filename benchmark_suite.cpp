@@ -0,0 +1,331 @@
+// A sweep of element types, sizes and operations over gerben::Vec, std::vector and protobuf's
+// repeated fields. Every row reports the heap allocations and bytes per iteration, counted by
+// interposing malloc, and the peak RSS of the process so far.
+//
+//   benchmark_suite --benchmark_filter='ReserveFill/.*<int>/1000$'
+
+#include "vector.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include <malloc.h>
+#include <sys/resource.h>
+
+#include "benchmark/benchmark.h"
+#include "google/protobuf/repeated_field.h"
+
+extern "C" {
+void* __libc_malloc(size_t);
+void* __libc_calloc(size_t, size_t);
+void* __libc_realloc(void*, size_t);
+void __libc_free(void*);
+}
+
+namespace {
+
+std::atomic<uint64_t> alloc_count{0};
+std::atomic<uint64_t> alloc_bytes{0};
+
+void CountAlloc(size_t bytes) {
+    alloc_count.fetch_add(1, std::memory_order_relaxed);
+    alloc_bytes.fetch_add(bytes, std::memory_order_relaxed);
+}
+
+}  // namespace
+
+// operator new and the default MemResource both end up here.
+extern "C" {
+void* malloc(size_t bytes) {
+    CountAlloc(bytes);
+    return __libc_malloc(bytes);
+}
+void* calloc(size_t n, size_t bytes) {
+    CountAlloc(n * bytes);
+    return __libc_calloc(n, bytes);
+}
+void* realloc(void* p, size_t bytes) {
+    CountAlloc(bytes);
+    return __libc_realloc(p, bytes);
+}
+void free(void* p) { __libc_free(p); }
+}
+
+namespace {
+
+// Counts allocations from construction to Report, which adds them to the state's counters.
+class AllocCounter {
+public:
+    AllocCounter() : count_(alloc_count.load()), bytes_(alloc_bytes.load()) {}
+
+    void Report(benchmark::State& state) const {
+        using benchmark::Counter;
+        state.counters["allocs"] = Counter(alloc_count.load() - count_, Counter::kAvgIterations);
+        state.counters["bytes"] = Counter(alloc_bytes.load() - bytes_, Counter::kAvgIterations);
+        rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        state.counters["peak_rss"] = Counter(double(usage.ru_maxrss) * 1024, Counter::kDefaults, Counter::kIs1024);
+    }
+
+private:
+    uint64_t count_;
+    uint64_t bytes_;
+};
+
+struct Pod64 {
+    uint64_t words[8];
+};
+
+// Keeps a pointer to itself, so moving it has to run the move constructor and Vec relocates it
+// with Relocate<T> instead of memcpy.
+struct SelfRef {
+    explicit SelfRef(uint32_t x) noexcept : self(this), value(x) {}
+    SelfRef(SelfRef&& other) noexcept : self(this), value(other.value) {}
+    SelfRef(const SelfRef& other) noexcept : self(this), value(other.value) {}
+    SelfRef& operator=(const SelfRef& other) noexcept {
+        value = other.value;
+        return *this;
+    }
+    SelfRef* self;
+    uint32_t value;
+};
+
+static_assert(!gerben::is_relocatable_v<SelfRef>);
+
+template <typename T>
+T Make(uint32_t i) {
+    if constexpr (std::is_same_v<T, int>) {
+        return i;
+    } else if constexpr (std::is_same_v<T, std::string>) {
+        // Mixes strings in the inline buffer with heap allocated ones.
+        return std::string(i & 31, 'a' + i % 26);
+    } else if constexpr (std::is_same_v<T, std::unique_ptr<int>>) {
+        return std::make_unique<int>(i);
+    } else if constexpr (std::is_same_v<T, Pod64>) {
+        return {{i, i, i, i, i, i, i, i}};
+    } else {
+        return T(i);
+    }
+}
+
+template <typename T>
+uint64_t Key(const T& x) {
+    if constexpr (std::is_same_v<T, int>) {
+        return x;
+    } else if constexpr (std::is_same_v<T, std::string>) {
+        return x.size();
+    } else if constexpr (std::is_same_v<T, std::unique_ptr<int>>) {
+        return *x;
+    } else if constexpr (std::is_same_v<T, Pod64>) {
+        return x.words[0];
+    } else {
+        return x.value;
+    }
+}
+
+// RepeatedField for scalars and RepeatedPtrField for strings, behind the subset of the vector
+// interface the suite uses. Neither has insert, so it appends and rotates like callers do.
+template <typename T>
+class ProtoVec {
+    using Rep = std::conditional_t<std::is_same_v<T, std::string>, google::protobuf::RepeatedPtrField<T>,
+                                   google::protobuf::RepeatedField<T>>;
+
+public:
+    void reserve(uint32_t n) { rep_.Reserve(n); }
+    void push_back(T x) { rep_.Add(std::move(x)); }
+    void pop_back() { rep_.RemoveLast(); }
+    void insert(typename Rep::iterator pos, T x) {
+        auto idx = pos - rep_.begin();
+        rep_.Add(std::move(x));
+        std::rotate(rep_.begin() + idx, rep_.end() - 1, rep_.end());
+    }
+    void erase(typename Rep::iterator pos) { rep_.erase(pos); }
+    void clear() { rep_.Clear(); }
+    uint32_t size() const { return rep_.size(); }
+    auto begin() { return rep_.begin(); }
+    auto end() { return rep_.end(); }
+    auto begin() const { return rep_.begin(); }
+    auto end() const { return rep_.end(); }
+
+private:
+    Rep rep_;
+};
+
+template <typename C>
+using Elem = std::remove_cvref_t<decltype(*std::declval<C&>().begin())>;
+
+template <typename C>
+void Fill(C& x, uint32_t n) {
+    for (uint32_t i = 0; i < n; i++) x.push_back(Make<Elem<C>>(i));
+}
+
+template <typename C>
+void BM_ReserveFill(benchmark::State& state) {
+    auto n = static_cast<uint32_t>(state.range(0));
+    AllocCounter allocs;
+    for (auto _ : state) {
+        C x;
+        x.reserve(n);
+        Fill(x, n);
+        benchmark::DoNotOptimize(&x);
+    }
+    allocs.Report(state);
+}
+
+// One insert in the middle per iteration, pop_back keeps the size at n.
+template <typename C>
+void BM_InsertMiddle(benchmark::State& state) {
+    auto n = static_cast<uint32_t>(state.range(0));
+    C x;
+    Fill(x, n);
+    AllocCounter allocs;
+    for (auto _ : state) {
+        x.insert(x.begin() + x.size() / 2, Make<Elem<C>>(n));
+        x.pop_back();
+        benchmark::DoNotOptimize(&x);
+    }
+    allocs.Report(state);
+}
+
+// One erase in the middle per iteration, push_back keeps the size at n.
+template <typename C>
+void BM_EraseMiddle(benchmark::State& state) {
+    auto n = static_cast<uint32_t>(state.range(0));
+    C x;
+    Fill(x, n + 1);
+    AllocCounter allocs;
+    for (auto _ : state) {
+        x.erase(x.begin() + x.size() / 2);
+        x.push_back(Make<Elem<C>>(n));
+        benchmark::DoNotOptimize(&x);
+    }
+    allocs.Report(state);
+}
+
+// After the first iteration the buffer is reused, so only element allocations remain.
+template <typename C>
+void BM_ClearReuse(benchmark::State& state) {
+    auto n = static_cast<uint32_t>(state.range(0));
+    C x;
+    AllocCounter allocs;
+    for (auto _ : state) {
+        Fill(x, n);
+        benchmark::DoNotOptimize(&x);
+        x.clear();
+    }
+    allocs.Report(state);
+}
+
+template <typename C>
+void BM_Copy(benchmark::State& state) {
+    auto n = static_cast<uint32_t>(state.range(0));
+    C x;
+    Fill(x, n);
+    AllocCounter allocs;
+    for (auto _ : state) {
+        C y(x);
+        benchmark::DoNotOptimize(&y);
+    }
+    allocs.Report(state);
+}
+
+template <typename C>
+void BM_Move(benchmark::State& state) {
+    auto n = static_cast<uint32_t>(state.range(0));
+    C x;
+    Fill(x, n);
+    AllocCounter allocs;
+    for (auto _ : state) {
+        C y(std::move(x));
+        benchmark::DoNotOptimize(&y);
+        x = std::move(y);
+    }
+    allocs.Report(state);
+}
+
+template <typename C>
+void BM_Iterate(benchmark::State& state) {
+    auto n = static_cast<uint32_t>(state.range(0));
+    C x;
+    Fill(x, n);
+    AllocCounter allocs;
+    for (auto _ : state) {
+        uint64_t sum = 0;
+        for (const auto& e : x) sum += Key(e);
+        benchmark::DoNotOptimize(sum);
+    }
+    allocs.Report(state);
+}
+
+// n inner vectors of 4 ints, growing the outer one relocates the inner ones.
+template <typename Outer>
+void BM_Nested(benchmark::State& state) {
+    auto n = static_cast<uint32_t>(state.range(0));
+    AllocCounter allocs;
+    for (auto _ : state) {
+        Outer x;
+        for (uint32_t i = 0; i < n; i++) {
+            x.emplace_back();
+            for (int j = 0; j < 4; j++) x.back().push_back(i + j);
+        }
+        benchmark::DoNotOptimize(&x);
+    }
+    allocs.Report(state);
+}
+
+// 0, 1, 10, ..., 10^8, stopping once the elements alone would pass 2 GiB.
+void Sizes(benchmark::internal::Benchmark* b, size_t elem_bytes) {
+    b->Arg(0);
+    for (int64_t n = 1; n <= 100'000'000 && n * elem_bytes <= (size_t{1} << 31); n *= 10) b->Arg(n);
+}
+
+template <typename Bench>
+void Register(const char* op, const char* container, const char* type, Bench bench, size_t elem_bytes) {
+    auto name = std::string(op) + "/" + container + "<" + type + ">";
+    auto b = benchmark::RegisterBenchmark(name.c_str(), bench);
+    Sizes(b, elem_bytes);
+}
+
+template <typename C>
+void RegisterOps(const char* container, const char* type, size_t elem_bytes) {
+    Register("ReserveFill", container, type, BM_ReserveFill<C>, elem_bytes);
+    Register("InsertMiddle", container, type, BM_InsertMiddle<C>, elem_bytes);
+    Register("EraseMiddle", container, type, BM_EraseMiddle<C>, elem_bytes);
+    Register("ClearReuse", container, type, BM_ClearReuse<C>, elem_bytes);
+    if constexpr (std::is_copy_constructible_v<Elem<C>>) {
+        Register("Copy", container, type, BM_Copy<C>, elem_bytes);
+    }
+    Register("Move", container, type, BM_Move<C>, elem_bytes);
+    Register("Iterate", container, type, BM_Iterate<C>, elem_bytes);
+}
+
+// Strings and unique_ptrs own a heap block each, count it towards the size limit.
+template <typename T>
+void RegisterType(const char* type) {
+    constexpr size_t kBytes = sizeof(T) + (std::is_same_v<T, int> || std::is_same_v<T, Pod64> ? 0 : 32);
+    RegisterOps<gerben::Vec<T>>("gerben::Vec", type, kBytes);
+    RegisterOps<std::vector<T>>("std::vector", type, kBytes);
+    if constexpr (std::is_same_v<T, int> || std::is_same_v<T, std::string>) {
+        RegisterOps<ProtoVec<T>>("ProtoVec", type, kBytes);
+    }
+}
+
+auto registered = [] {
+    RegisterType<int>("int");
+    RegisterType<std::string>("std::string");
+    RegisterType<std::unique_ptr<int>>("unique_ptr<int>");
+    RegisterType<Pod64>("Pod64");
+    RegisterType<SelfRef>("SelfRef");
+    constexpr size_t kNestedBytes = 16 + 48;
+    Register("Nested", "gerben::Vec", "Vec<int>", BM_Nested<gerben::Vec<gerben::Vec<int>>>, kNestedBytes);
+    Register("Nested", "std::vector", "vector<int>", BM_Nested<std::vector<std::vector<int>>>, kNestedBytes);
+    return 0;
+}();
+
+}  // namespace
@@ -0,0 +1,2 @@
+// The call sites are kept by [[gnu::used]], nothing needs to run.
+int main() { return 0; }
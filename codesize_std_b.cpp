@@ -0,0 +1,6 @@
+#include <vector>
+
+template <typename T>
+using Container = std::vector<T>;
+
+#include "codesize_calls.inc"
@@ -0,0 +1,78 @@
+"""Compares the .text the call sites in codesize_calls.inc cost with gerben::Vec and std::vector.
+
+Prints the size of every call site and the total each container adds over an empty binary, then
+fails if the Vec total crosses --max_vec_bytes, if it is more than --max_ratio of the std::vector
+total, or if a Relocate<T> got linked in more than once for the same T.
+"""
+
+import argparse
+import collections
+import re
+import subprocess
+import sys
+
+CALL_SITE = re.compile(r"^\(anonymous namespace\)::((?:PushBack|Insert|Resize|Erase)\w+)\(")
+RELOCATE = re.compile(r"^(?:void )?gerben::VecBase::Relocate<(.+)>\(void\*, void\*, unsigned int\)$")
+
+
+def text_symbols(binary):
+    """Returns (name, size) of every defined function in binary, duplicates included."""
+    out = subprocess.run(["nm", "-S", "-C", "--defined-only", binary], check=True,
+                         capture_output=True, text=True).stdout
+    symbols = []
+    for line in out.splitlines():
+        parts = line.split(None, 3)
+        if len(parts) == 4 and parts[2] in "tTwW":
+            symbols.append((parts[3], int(parts[1], 16)))
+    return symbols
+
+
+def added_bytes(symbols, baseline):
+    names = {name for name, _ in baseline}
+    return sum(size for name, size in symbols if name not in names)
+
+
+def call_sites(symbols):
+    sites = collections.defaultdict(list)
+    for name, size in symbols:
+        m = CALL_SITE.match(name)
+        if m:
+            sites[m.group(1)].append(size)
+    return sites
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument("--vec", required=True)
+    parser.add_argument("--std", required=True)
+    parser.add_argument("--baseline", required=True)
+    parser.add_argument("--max_vec_bytes", type=int, required=True)
+    parser.add_argument("--max_ratio", type=float, required=True)
+    args = parser.parse_args()
+
+    vec, std, baseline = (text_symbols(b) for b in (args.vec, args.std, args.baseline))
+    vec_sites, std_sites = call_sites(vec), call_sites(std)
+    print(f"{'call site':<24}{'Vec':>8}{'vector':>8}")
+    for name in sorted(vec_sites.keys() | std_sites.keys()):
+        print(f"{name:<24}{max(vec_sites[name], default=0):>8}{max(std_sites[name], default=0):>8}")
+    vec_total, std_total = added_bytes(vec, baseline), added_bytes(std, baseline)
+    print(f"{'total .text':<24}{vec_total:>8}{std_total:>8}")
+
+    ok = True
+    if vec_total > args.max_vec_bytes:
+        print(f"FAIL: Vec adds {vec_total} bytes, the budget is {args.max_vec_bytes}")
+        ok = False
+    if vec_total > args.max_ratio * std_total:
+        print(f"FAIL: Vec adds {vec_total / std_total:.2f}x of std::vector, the budget is {args.max_ratio}x")
+        ok = False
+    relocates = collections.Counter(m.group(1) for m in map(RELOCATE.match, (n for n, _ in vec)) if m)
+    for t, count in sorted(relocates.items()):
+        print(f"Relocate<{t}>: {count}")
+        if count != 1:
+            print(f"FAIL: {count} copies of Relocate<{t}> survived linking")
+            ok = False
+    return 0 if ok else 1
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,6 @@
+#include "vector.hpp"
+
+template <typename T>
+using Container = gerben::Vec<T>;
+
+#include "codesize_calls.inc"
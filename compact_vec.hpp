@@ -0,0 +1,160 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <utility>
+
+#include "vector.hpp"
+
+namespace gerben {
+
+// A vector that is a single pointer, for members of objects that exist by the million and are
+// mostly empty. Size and capacity live in the otherwise unused part of the hidden buffer header,
+// next to the MemResource*, so an empty vector allocates nothing. Growing goes through the same
+// outlined paths as Vec. The price is that size lives in memory the elements could alias, so a
+// push_back loop can't keep it in a register the way Vec does.
+template <typename T, GrowthPolicy G = GrowthPolicy{}>
+class CompactVec {
+    static_assert(std::is_nothrow_move_constructible_v<T>);
+public:
+    constexpr CompactVec() noexcept = default;
+    explicit CompactVec(MemResource* mr) noexcept : bits_(reinterpret_cast<uintptr_t>(mr) | kNoBuffer) {}
+    ~CompactVec() noexcept {
+        clear();
+        Free();
+    }
+
+    CompactVec(CompactVec&& other) noexcept { swap(other); }
+    CompactVec& operator=(CompactVec&& other) noexcept {
+        swap(other);
+        return *this;
+    }
+    void swap(CompactVec& other) noexcept { std::swap(bits_, other.bits_); }
+
+    uint32_t size() const noexcept { return HasBuffer() ? Counts().size : 0; }
+    uint32_t capacity() const noexcept { return HasBuffer() ? Counts().cap : 0; }
+    bool empty() const noexcept { return size() == 0; }
+
+    T* data() noexcept { return HasBuffer() ? reinterpret_cast<T*>(bits_) : nullptr; }
+    T const* data() const noexcept { return HasBuffer() ? reinterpret_cast<T const*>(bits_) : nullptr; }
+    T* begin() noexcept { return data(); }
+    T const* begin() const noexcept { return data(); }
+    T* end() noexcept { return data() + size(); }
+    T const* end() const noexcept { return data() + size(); }
+
+    T& operator[](uint32_t idx) noexcept { return data()[idx]; }
+    T const& operator[](uint32_t idx) const noexcept { return data()[idx]; }
+    T& front() noexcept { return data()[0]; }
+    T const& front() const noexcept { return data()[0]; }
+    T& back() noexcept { return data()[size() - 1]; }
+    T const& back() const noexcept { return data()[size() - 1]; }
+
+    operator std::span<T>() noexcept { return {data(), size()}; }
+    operator std::span<T const>() const noexcept { return {data(), size()}; }
+
+    void reserve(uint32_t newcap) noexcept {
+        if (newcap > capacity()) Grow(newcap);
+    }
+
+    void push_back(const T& x) noexcept { emplace_back(x); }
+    void push_back(T&& x) noexcept { emplace_back(std::move(x)); }
+
+    template <typename... Args>
+    T& emplace_back(Args&&... args) noexcept {
+        if (!HasBuffer() || Counts().size == Counts().cap) {
+            // args may refer into the buffer, so construct before growing it.
+            T tmp(std::forward<Args>(args)...);
+            Grow();
+            return *new (Slot()) T(std::move(tmp));
+        }
+        return *new (Slot()) T(std::forward<Args>(args)...);
+    }
+
+    T pop_back() noexcept {
+        auto& c = Counts();
+        auto p = reinterpret_cast<T*>(bits_) + --c.size;
+        T res = std::move(*p);
+        p->~T();
+        return res;
+    }
+
+    void clear() noexcept {
+        if (!HasBuffer()) return;
+        std::destroy_n(data(), size());
+        Counts().size = 0;
+    }
+
+    void resize(uint32_t s) noexcept {
+        auto n = size();
+        if (s <= n) {
+            std::destroy(data() + s, data() + n);
+        } else {
+            reserve(s);
+            for (auto p = data() + n; p != data() + s; ++p) new (p) T();
+        }
+        if (HasBuffer()) Counts().size = s;
+    }
+
+    // An empty vector gives up its buffer altogether.
+    void shrink_to_fit() noexcept {
+        if (!HasBuffer() || Counts().size == Counts().cap) return;
+        auto c = Counts();
+        auto [base, cap] = VecBase::ReallocOutline(reinterpret_cast<void*>(bits_), c.size, c.cap, sizeof(T), Mover(), c.size);
+        Install(base, c.size, cap);
+    }
+
+private:
+    struct Sizes {
+        uint32_t size;
+        uint32_t cap;
+    };
+    // Bytes [-16, -8) of the header, right in front of the MemResource*.
+    static_assert(sizeof(Sizes) == sizeof(uintptr_t) && kVecHeaderSize >= 2 * sizeof(Sizes));
+
+    // Set when bits_ is a MemResource* rather than a buffer, nullptr meaning the default.
+    static constexpr uintptr_t kNoBuffer = 1;
+
+    bool HasBuffer() const noexcept { return (bits_ & kNoBuffer) == 0; }
+    // The word in front of the MemResource* at the end of the header.
+    Sizes& Counts() const noexcept { return reinterpret_cast<Sizes*>(bits_)[-2]; }
+    T* Slot() noexcept {
+        auto& c = Counts();
+        return reinterpret_cast<T*>(bits_) + c.size++;
+    }
+
+    static VecBase::Relocator Mover() noexcept {
+        if constexpr (is_relocatable_v<T>) {
+            return nullptr;
+        } else {
+            return &VecBase::Relocate<T>;
+        }
+    }
+
+    void Install(void* base, uint32_t size, uint32_t cap) noexcept {
+        if (cap == 0) {
+            bits_ = reinterpret_cast<uintptr_t>(base) | kNoBuffer;
+        } else {
+            bits_ = reinterpret_cast<uintptr_t>(base);
+            Counts() = {size, cap};
+        }
+    }
+
+    void Grow(uint32_t newcap = 0) noexcept {
+        Sizes c = {0, 0};
+        void* base = reinterpret_cast<void*>(bits_ & ~kNoBuffer);
+        if (HasBuffer()) c = Counts();
+        auto [newbase, cap] = VecBase::GrowOutline(base, c.size, c.cap, sizeof(T), Mover(), newcap, G);
+        Install(newbase, c.size, cap);
+    }
+
+    void Free() noexcept {
+        if (HasBuffer()) VecBase::FreeOutline(reinterpret_cast<void*>(bits_), Counts().cap * sizeof(T));
+    }
+
+    uintptr_t bits_ = kNoBuffer;
+};
+
+template <typename T, GrowthPolicy G>
+inline constexpr bool is_known_relocatable_v<CompactVec<T, G>> = true;
+
+}  // namespace gerben
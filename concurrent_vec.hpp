@@ -0,0 +1,143 @@
+#pragma once
+
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <utility>
+
+#include "vector.hpp"
+
+namespace gerben {
+
+// An append only vector many threads can push into at once without locks. Elements live in
+// segments that double in size and never move, so a push is a fetch_add on the size plus, once
+// per segment, installing the segment with a CAS. Pushed elements may be read by another thread
+// once it is synchronized with the pusher (e.g. joined it). size() counts slots claimed, which
+// includes elements still being constructed. Once the producers are done, freeze() moves the
+// contents into a plain Vec with one memcpy per segment.
+template <IsNoThrowMoveConstructible T>
+class ConcurrentVec {
+public:
+    explicit ConcurrentVec(MemResource* mr = DefaultResource()) noexcept : mr_(mr) {}
+    ~ConcurrentVec() noexcept {
+        clear();
+        FreeSegments();
+    }
+
+    ConcurrentVec(const ConcurrentVec&) = delete;
+    ConcurrentVec& operator=(const ConcurrentVec&) = delete;
+
+    uint32_t size() const noexcept { return size_.load(std::memory_order_acquire); }
+    bool empty() const noexcept { return size() == 0; }
+
+    T& operator[](uint32_t idx) noexcept { return *Locate(idx); }
+    T const& operator[](uint32_t idx) const noexcept { return *Locate(idx); }
+
+    template <typename... Args>
+    T& emplace_back(Args&&... args) noexcept {
+        auto idx = size_.fetch_add(1, std::memory_order_relaxed);
+        return *new (Slot(idx)) T(std::forward<Args>(args)...);
+    }
+    T& push_back(const T& x) noexcept { return emplace_back(x); }
+    T& push_back(T&& x) noexcept { return emplace_back(std::move(x)); }
+
+    // Claims n consecutive slots with a single fetch_add, fills them with copies of x and
+    // returns the index of the first.
+    uint32_t grow_by(uint32_t n, const T& x) noexcept {
+        auto first = size_.fetch_add(n, std::memory_order_relaxed);
+        ForSegments(first, first + n, [&x](T* p, uint32_t k) { std::uninitialized_fill_n(p, k, x); });
+        return first;
+    }
+    uint32_t grow_by(uint32_t n) noexcept requires std::is_default_constructible_v<T> {
+        auto first = size_.fetch_add(n, std::memory_order_relaxed);
+        ForSegments(first, first + n, [](T* p, uint32_t k) { std::uninitialized_value_construct_n(p, k); });
+        return first;
+    }
+
+    // Not thread safe, like freeze().
+    void clear() noexcept {
+        ForSegments(0, size(), [](T* p, uint32_t k) { std::destroy_n(p, k); });
+        size_.store(0, std::memory_order_relaxed);
+    }
+
+    // Moves all elements into one contiguous Vec allocated from the same resource and leaves
+    // this empty. Must not race with producers.
+    Vec<T> freeze() noexcept {
+        Vec<T> v(mr_);
+        auto n = size();
+        v.append_with(n, [&](T* dst) {
+            ForSegments(0, n, [&dst](T* p, uint32_t k) {
+                if constexpr (is_relocatable_v<T>) {
+                    std::memcpy(static_cast<void*>(dst), p, size_t{k} * sizeof(T));
+                } else {
+                    std::uninitialized_move_n(p, k, dst);
+                    std::destroy_n(p, k);
+                }
+                dst += k;
+            });
+        });
+        size_.store(0, std::memory_order_relaxed);
+        FreeSegments();
+        return v;
+    }
+
+private:
+    // Segment s holds kBase << s elements starting at index kBase * (2^s - 1), the first segment
+    // is around 512 bytes.
+    static constexpr uint32_t kBaseShift = std::max(1, 10 - static_cast<int>(std::bit_width(sizeof(T))));
+    static constexpr uint64_t kBase = uint64_t{1} << kBaseShift;
+    static constexpr uint32_t kMaxSegments = 33 - kBaseShift;
+
+    static uint32_t SegmentOf(uint64_t idx) noexcept { return std::bit_width(idx / kBase + 1) - 1; }
+    static uint64_t SegmentStart(uint32_t s) noexcept { return kBase * ((uint64_t{1} << s) - 1); }
+    static uint64_t SegmentLen(uint32_t s) noexcept { return kBase << s; }
+
+    T* Locate(uint32_t idx) const noexcept {
+        auto s = SegmentOf(idx);
+        return segments_[s].load(std::memory_order_acquire) + (idx - SegmentStart(s));
+    }
+
+    T* Slot(uint32_t idx) noexcept {
+        auto s = SegmentOf(idx);
+        return Segment(s) + (idx - SegmentStart(s));
+    }
+
+    // Threads that find a segment missing all allocate it, the loser of the CAS gives its
+    // allocation back. That only happens once per segment and beats having pushers wait.
+    T* Segment(uint32_t s) noexcept {
+        auto seg = segments_[s].load(std::memory_order_acquire);
+        if (seg != nullptr) return seg;
+        auto fresh = static_cast<T*>(mr_->allocate(SegmentLen(s) * sizeof(T), alignof(T)));
+        if (segments_[s].compare_exchange_strong(seg, fresh, std::memory_order_acq_rel)) return fresh;
+        mr_->deallocate(fresh, SegmentLen(s) * sizeof(T), alignof(T));
+        return seg;
+    }
+
+    // Calls f(p, k) for the runs of slots [begin, end) that are contiguous within a segment.
+    template <typename F>
+    void ForSegments(uint64_t begin, uint64_t end, F f) noexcept {
+        while (begin < end) {
+            auto s = SegmentOf(begin);
+            auto k = std::min(end, SegmentStart(s) + SegmentLen(s)) - begin;
+            f(Segment(s) + (begin - SegmentStart(s)), static_cast<uint32_t>(k));
+            begin += k;
+        }
+    }
+
+    void FreeSegments() noexcept {
+        for (uint32_t s = 0; s < kMaxSegments; s++) {
+            if (auto seg = segments_[s].exchange(nullptr, std::memory_order_relaxed)) {
+                mr_->deallocate(seg, SegmentLen(s) * sizeof(T), alignof(T));
+            }
+        }
+    }
+
+    MemResource* const mr_;
+    std::atomic<T*> segments_[kMaxSegments] = {};
+    // Written by every push, kept off the cache line of the read mostly segment table.
+    alignas(64) std::atomic<uint32_t> size_{0};
+};
+
+}  // namespace gerben
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <ranges>
+#include <span>
+#include <utility>
+
+#include "vector.hpp"
+
+namespace gerben {
+
+// A vector with room for N elements inside the object and no heap at all, so it can be a
+// constexpr variable. Meant for lookup tables computed at compile time: build them in a Vec (or
+// anything else with iterators) in a constexpr function and copy that into a FixedVec, which
+// lands in read only data instead of being filled in at startup. Slots past size() hold value
+// initialized elements, so T must be default constructible. Pushing past N is undefined, and an
+// error in constant evaluation.
+template <typename T, uint32_t N>
+class FixedVec {
+public:
+    using value_type = T;
+
+    constexpr FixedVec() noexcept = default;
+    template <std::ranges::input_range R>
+    explicit constexpr FixedVec(R&& r) noexcept {
+        for (auto&& x : r) emplace_back(std::forward<decltype(x)>(x));
+    }
+
+    constexpr uint32_t size() const noexcept { return size_; }
+    constexpr bool empty() const noexcept { return size_ == 0; }
+    static constexpr uint32_t capacity() noexcept { return N; }
+
+    constexpr T* data() noexcept { return data_.data(); }
+    constexpr T const* data() const noexcept { return data_.data(); }
+    constexpr T* begin() noexcept { return data(); }
+    constexpr T const* begin() const noexcept { return data(); }
+    constexpr T* end() noexcept { return data() + size_; }
+    constexpr T const* end() const noexcept { return data() + size_; }
+
+    constexpr T& operator[](uint32_t idx) noexcept { return data_[idx]; }
+    constexpr T const& operator[](uint32_t idx) const noexcept { return data_[idx]; }
+    constexpr T& front() noexcept { return data_[0]; }
+    constexpr T const& front() const noexcept { return data_[0]; }
+    constexpr T& back() noexcept { return data_[size_ - 1]; }
+    constexpr T const& back() const noexcept { return data_[size_ - 1]; }
+
+    constexpr operator std::span<T const>() const noexcept { return {data(), size_}; }
+
+    template <typename... Args>
+    constexpr T& emplace_back(Args&&... args) noexcept {
+        auto& slot = data_[size_++];
+        slot = T(std::forward<Args>(args)...);
+        return slot;
+    }
+    constexpr void push_back(const T& x) noexcept { emplace_back(x); }
+    constexpr void push_back(T&& x) noexcept { emplace_back(std::move(x)); }
+
+    constexpr T pop_back() noexcept { return std::exchange(data_[--size_], T()); }
+    constexpr void clear() noexcept {
+        while (size_ != 0) pop_back();
+    }
+
+    friend constexpr bool operator==(const FixedVec& a, const FixedVec& b) noexcept {
+        return std::ranges::equal(a, b);
+    }
+
+private:
+    std::array<T, N> data_{};
+    uint32_t size_ = 0;
+};
+
+template <typename T, uint32_t N>
+inline constexpr bool is_known_relocatable_v<FixedVec<T, N>> = is_relocatable_v<T>;
+
+// Evaluates make, a captureless lambda returning a sized range such as a Vec, at compile time
+// and returns the result as a FixedVec of exactly its size. make runs twice, once to learn the
+// size, since its allocations can't outlive the evaluation.
+//
+//   constexpr auto kSquares = ToFixedVec<[] {
+//       Vec<uint32_t> v;
+//       for (uint32_t i = 0; i < 256; i++) v.push_back(i * i);
+//       return v;
+//   }>();
+template <auto make>
+consteval auto ToFixedVec() {
+    constexpr auto n = static_cast<uint32_t>(std::ranges::size(make()));
+    return FixedVec<std::ranges::range_value_t<decltype(make())>, n>(make());
+}
+
+}  // namespace gerben
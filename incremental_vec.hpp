@@ -0,0 +1,182 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <span>
+#include <utility>
+
+#include "vector.hpp"
+
+namespace gerben {
+
+// A vector that never pays for a whole copy in one call. When it runs out of capacity it
+// allocates the bigger buffer through GrowOutline but leaves the elements in the old one, and
+// every following push_back relocates the next K of them, like incremental rehashing. While
+// that's going on, indices [migrated_, old_size_) still live in the old buffer, so element
+// access checks which buffer to use and there's no contiguous data() until finish_migration().
+// With the default growth factor of 2 the new buffer has as many free slots as there are
+// elements to migrate, so any K >= 1 finishes before it fills. If it does fill first, the rest is
+// migrated at once.
+template <IsNoThrowMoveConstructible T, uint32_t K = 4, GrowthPolicy G = GrowthPolicy{}>
+class IncrementalVec {
+    static_assert(K > 0);
+public:
+    IncrementalVec() noexcept = default;
+    explicit IncrementalVec(MemResource* mr) noexcept : mr_(mr) {}
+    ~IncrementalVec() noexcept {
+        clear();
+        Free(base_, cap_);
+    }
+
+    IncrementalVec(IncrementalVec&& other) noexcept { swap(other); }
+    IncrementalVec& operator=(IncrementalVec&& other) noexcept {
+        swap(other);
+        return *this;
+    }
+    void swap(IncrementalVec& other) noexcept {
+        std::swap(base_, other.base_);
+        std::swap(old_, other.old_);
+        std::swap(size_, other.size_);
+        std::swap(cap_, other.cap_);
+        std::swap(migrated_, other.migrated_);
+        std::swap(old_size_, other.old_size_);
+        std::swap(old_cap_, other.old_cap_);
+        std::swap(mr_, other.mr_);
+    }
+
+    uint32_t size() const noexcept { return size_; }
+    bool empty() const noexcept { return size_ == 0; }
+    uint32_t capacity() const noexcept { return cap_; }
+    bool migrating() const noexcept { return old_ != nullptr; }
+
+    T& operator[](uint32_t idx) noexcept { return *Locate(idx); }
+    T const& operator[](uint32_t idx) const noexcept { return *Locate(idx); }
+    T& back() noexcept { return *Locate(size_ - 1); }
+    T const& back() const noexcept { return *Locate(size_ - 1); }
+
+    // Relocates whatever is left in the old buffer, after which data() covers all elements.
+    void finish_migration() noexcept {
+        if (old_) Migrate(old_size_ - migrated_);
+    }
+    T* data() noexcept {
+        finish_migration();
+        return base_;
+    }
+    operator std::span<T>() noexcept { return {data(), size_}; }
+
+    template <typename... Args>
+    T& emplace_back(Args&&... args) noexcept {
+        if (size_ == cap_) [[unlikely]] {
+            // args may refer into the buffer, so construct before growing it.
+            T tmp(std::forward<Args>(args)...);
+            Grow();
+            return Push(std::move(tmp));
+        }
+        return Push(std::forward<Args>(args)...);
+    }
+    void push_back(const T& x) noexcept { emplace_back(x); }
+    void push_back(T&& x) noexcept { emplace_back(std::move(x)); }
+
+    T pop_back() noexcept {
+        auto p = Locate(--size_);
+        T res = std::move(*p);
+        p->~T();
+        old_size_ = std::min(old_size_, size_);
+        if (old_ && migrated_ == old_size_) Migrate(0);
+        return res;
+    }
+
+    void clear() noexcept {
+        for (uint32_t i = 0; i < size_; i++) Locate(i)->~T();
+        size_ = 0;
+        old_size_ = migrated_;
+        if (old_) Migrate(0);
+    }
+
+    // Unlike growth in push_back this moves everything right away.
+    void reserve(uint32_t newcap) noexcept {
+        if (newcap <= cap_) return;
+        finish_migration();
+        if (cap_ == 0) {
+            Install(VecBase::GrowOutline(mr_, 0, 0, sizeof(T), Mover(), newcap, G));
+        } else {
+            Install(VecBase::ReallocOutline(base_, size_, cap_, sizeof(T), Mover(), newcap));
+        }
+    }
+
+private:
+    static VecBase::Relocator Mover() noexcept {
+        if constexpr (is_relocatable_v<T>) {
+            return nullptr;
+        } else {
+            return &VecBase::Relocate<T>;
+        }
+    }
+
+    T* Locate(uint32_t idx) const noexcept {
+        if (old_ && idx >= migrated_ && idx < old_size_) [[unlikely]] return old_ + idx;
+        return base_ + idx;
+    }
+
+    template <typename... Args>
+    T& Push(Args&&... args) noexcept {
+        auto p = new (base_ + size_) T(std::forward<Args>(args)...);
+        size_++;
+        if (old_) Migrate(std::min(K, old_size_ - migrated_));
+        return *p;
+    }
+
+    // Relocates the next n elements out of the old buffer, and frees it once it is empty.
+    void Migrate(uint32_t n) noexcept {
+        if constexpr (is_relocatable_v<T>) {
+            std::memcpy(static_cast<void*>(base_ + migrated_), old_ + migrated_, size_t{n} * sizeof(T));
+        } else {
+            VecBase::Relocate<T>(base_ + migrated_, old_ + migrated_, n);
+        }
+        migrated_ += n;
+        if (migrated_ == old_size_) {
+            Free(old_, old_cap_);
+            old_ = nullptr;
+            old_cap_ = 0;
+        }
+    }
+
+    // The fresh buffer comes from GrowOutline's empty vector path, which picks the capacity per
+    // the policy. The old elements stay where they are.
+    void Grow() noexcept {
+        finish_migration();
+        auto cap = std::max<uint64_t>(cap_ + 1, uint64_t{cap_} * G.numerator / G.denominator);
+        auto [base, newcap] = VecBase::GrowOutline(mr_, 0, 0, sizeof(T), Mover(), std::min<uint64_t>(cap, UINT32_MAX), G);
+        old_ = size_ != 0 ? base_ : nullptr;
+        old_cap_ = old_ ? cap_ : 0;
+        if (old_ == nullptr) Free(base_, cap_);
+        old_size_ = size_;
+        migrated_ = 0;
+        base_ = static_cast<T*>(base);
+        cap_ = newcap;
+    }
+
+    void Install(std::pair<void*, uint32_t> buffer) noexcept {
+        base_ = static_cast<T*>(buffer.first);
+        cap_ = buffer.second;
+    }
+
+    static void Free(T* base, uint32_t cap) noexcept {
+        if (cap != 0) VecBase::FreeOutline(base, size_t{cap} * sizeof(T));
+    }
+
+    T* base_ = nullptr;
+    T* old_ = nullptr;
+    uint32_t size_ = 0;
+    uint32_t cap_ = 0;
+    uint32_t migrated_ = 0;
+    uint32_t old_size_ = 0;
+    uint32_t old_cap_ = 0;
+    MemResource* mr_ = nullptr;
+};
+
+template <typename T, uint32_t K, GrowthPolicy G>
+inline constexpr bool is_known_relocatable_v<IncrementalVec<T, K, G>> = true;
+
+}  // namespace gerben
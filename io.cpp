@@ -0,0 +1,39 @@
+#include "io.hpp"
+
+#include <cerrno>
+
+#include <unistd.h>
+
+namespace gerben {
+
+int64_t ReadFd(int fd, void* dst, size_t n) noexcept {
+    for (;;) {
+        auto res = ::read(fd, dst, n);
+        if (res >= 0 || errno != EINTR) return res;
+    }
+}
+
+int64_t WriteAllFd(int fd, iovec* iov, int n) noexcept {
+    int64_t total = 0;
+    while (n > 0) {
+        auto res = ::writev(fd, iov, n);
+        if (res < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        total += res;
+        // Skip what was written, resuming a partially written iovec where it stopped.
+        while (n > 0 && static_cast<size_t>(res) >= iov->iov_len) {
+            res -= iov->iov_len;
+            iov++;
+            n--;
+        }
+        if (n > 0) {
+            iov->iov_base = static_cast<char*>(iov->iov_base) + res;
+            iov->iov_len -= res;
+        }
+    }
+    return total;
+}
+
+}  // namespace gerben
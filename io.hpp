@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+#include <sys/uio.h>
+
+#include "vector.hpp"
+
+namespace gerben {
+
+template <typename T>
+concept IoByte = sizeof(T) == 1 && std::is_trivially_copyable_v<T>;
+
+// read() retrying on EINTR, returning -1 with errno set on other errors.
+int64_t ReadFd(int fd, void* dst, size_t n) noexcept;
+// Writes all of iov, retrying on EINTR and resuming after partial writes. Returns the bytes
+// written, or -1 with errno set.
+int64_t WriteAllFd(int fd, iovec* iov, int n) noexcept;
+
+inline constexpr size_t kDefaultReadHint = 64 << 10;
+
+// Reads once from fd (a file, pipe or socket) straight into the tail of v, with no staging
+// buffer and no zero fill. Asks for at least hint bytes, or all the spare capacity if that's
+// more. Returns the bytes appended, 0 at end of file, -1 with errno set on error, EFBIG if v is
+// already at the maximum size.
+template <IoByte T, GrowthPolicy G>
+int64_t append_from_fd(Vec<T, G>& v, int fd, size_t hint = kDefaultReadHint) noexcept {
+    // A zero length read returns 0 too, which would pass for end of file.
+    if (v.size() == UINT32_MAX) {
+        errno = EFBIG;
+        return -1;
+    }
+    auto want = std::max<uint64_t>({hint, v.capacity() - v.size(), 1});
+    auto n = static_cast<uint32_t>(std::min<uint64_t>(want, UINT32_MAX - v.size()));
+    int64_t res = 0;
+    v.append_with(n, [&](T* dst) {
+        res = ReadFd(fd, dst, n);
+        return res > 0 ? static_cast<uint32_t>(res) : 0;
+    });
+    return res;
+}
+
+// Reads fd until end of file, growing v as it goes. Returns the bytes appended, or -1 with errno
+// set, in which case what was read before the error stays appended.
+template <IoByte T, GrowthPolicy G>
+int64_t append_all_from_fd(Vec<T, G>& v, int fd, size_t hint = kDefaultReadHint) noexcept {
+    int64_t total = 0;
+    for (;;) {
+        auto res = append_from_fd(v, fd, hint);
+        if (res <= 0) return res < 0 ? res : total;
+        total += res;
+    }
+}
+
+// Writes the concatenation of bufs to fd with writev, without joining them first. Returns the
+// bytes written, or -1 with errno set.
+template <IoByte T, GrowthPolicy G, GrowthPolicy G2>
+int64_t writev(int fd, const Vec<Vec<T, G>, G2>& bufs) noexcept {
+    constexpr int kBatch = 64;
+    iovec iov[kBatch];
+    int n = 0;
+    int64_t total = 0;
+    for (auto& b : bufs) {
+        if (b.empty()) continue;
+        iov[n++] = {const_cast<T*>(b.data()), b.size()};
+        if (n == kBatch) {
+            auto res = WriteAllFd(fd, iov, n);
+            if (res < 0) return res;
+            total += res;
+            n = 0;
+        }
+    }
+    if (n != 0) {
+        auto res = WriteAllFd(fd, iov, n);
+        if (res < 0) return res;
+        total += res;
+    }
+    return total;
+}
+
+}  // namespace gerben
@@ -0,0 +1,103 @@
+#include "mapped_vec.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+
+namespace gerben {
+
+namespace {
+
+bool WriteAll(int fd, const void* data, size_t n) {
+    auto p = static_cast<const char*>(data);
+    while (n > 0) {
+        auto k = write(fd, p, n);
+        if (k < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        p += k;
+        n -= k;
+    }
+    return true;
+}
+
+}  // namespace
+
+bool SaveVecBytes(const char* path, const void* data, uint32_t count, uint32_t elem_size, uint32_t elem_align, uint64_t type_tag) noexcept {
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) return false;
+    char prefix[MappedVecHeader::kDataOffset] = {};
+    MappedVecHeader header;
+    std::memcpy(header.magic, MappedVecHeader::kMagic, sizeof(header.magic));
+    header.elem_size = elem_size;
+    header.elem_align = elem_align;
+    header.count = count;
+    header.type_tag = type_tag;
+    std::memcpy(prefix, &header, sizeof(header));
+    bool ok = WriteAll(fd, prefix, sizeof(prefix)) && WriteAll(fd, data, size_t{count} * elem_size);
+    int err = errno;
+    if (close(fd) != 0 && ok) return false;
+    errno = err;
+    return ok;
+}
+
+MappedFile::~MappedFile() noexcept {
+    if (mapping_) munmap(mapping_, length_);
+}
+
+bool MappedFile::Map(const char* path, Mode mode, uint32_t elem_size, uint32_t elem_align, uint64_t type_tag, void** base, uint32_t* count) noexcept {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+    struct stat st;
+    MappedVecHeader header;
+    bool ok = fstat(fd, &st) == 0 && pread(fd, &header, sizeof(header), 0) == sizeof(header);
+    if (ok && (std::memcmp(header.magic, MappedVecHeader::kMagic, sizeof(header.magic)) != 0 ||
+               header.elem_size != elem_size || header.elem_align != elem_align || header.type_tag != type_tag ||
+               header.count > UINT32_MAX ||
+               static_cast<uint64_t>(st.st_size) != MappedVecHeader::kDataOffset + header.count * elem_size)) {
+        errno = EINVAL;
+        ok = false;
+    }
+    void* mapping = MAP_FAILED;
+    size_t length = st.st_size;
+    if (ok && header.count > 0) {
+        // Private so the header slot can hold our MemResource* without touching the file.
+        mapping = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        ok = mapping != MAP_FAILED;
+    }
+    int err = errno;
+    close(fd);
+    errno = err;
+    if (!ok) return false;
+    *base = nullptr;
+    *count = header.count;
+    if (header.count == 0) return true;
+    if (mode == kReadOnly) {
+        long page = sysconf(_SC_PAGESIZE);
+        if (length > static_cast<size_t>(page)) mprotect(static_cast<std::byte*>(mapping) + page, length - page, PROT_READ);
+    }
+    mapping_ = mapping;
+    length_ = length;
+    *base = static_cast<std::byte*>(mapping) + MappedVecHeader::kDataOffset;
+    return true;
+}
+
+void* MappedFile::do_allocate(size_t bytes, size_t alignment) {
+    return DefaultResource()->allocate(bytes, alignment);
+}
+
+void MappedFile::do_deallocate(void* p, size_t bytes, size_t alignment) {
+    if (p == static_cast<std::byte*>(mapping_) + MappedVecHeader::kDataOffset - sizeof(std::max_align_t)) {
+        munmap(mapping_, length_);
+        mapping_ = nullptr;
+    } else {
+        DefaultResource()->deallocate(p, bytes, alignment);
+    }
+}
+
+}  // namespace gerben
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <string_view>
+#include <type_traits>
+
+#include "vector.hpp"
+
+namespace gerben {
+
+// File format shared by SaveVec and MappedVec. The elements start at kDataOffset, preceded by
+// room for the hidden MemResource* header of Vec buffers, so a mapping of the file can be used
+// as the buffer of a Vec as is.
+struct MappedVecHeader {
+    static constexpr char kMagic[8] = "GVECv01";
+    static constexpr size_t kDataOffset = 32 + sizeof(std::max_align_t);
+
+    char magic[8];
+    uint32_t elem_size;
+    uint32_t elem_align;
+    uint64_t count;
+    uint64_t type_tag;
+};
+static_assert(sizeof(MappedVecHeader) <= MappedVecHeader::kDataOffset - sizeof(std::max_align_t));
+
+// Identifies T in the file header. Derived from the type's name as spelled by the compiler, so
+// it's only stable between builds of the same compiler.
+template <typename T>
+constexpr uint64_t TypeTag() {
+    std::string_view name = __PRETTY_FUNCTION__;
+    uint64_t h = 0xcbf29ce484222325;
+    for (char c : name) h = (h ^ static_cast<unsigned char>(c)) * 0x100000001b3;
+    return h;
+}
+
+// Returns false on failure with errno set.
+bool SaveVecBytes(const char* path, const void* data, uint32_t count, uint32_t elem_size, uint32_t elem_align, uint64_t type_tag) noexcept;
+
+template <typename T>
+    requires std::is_trivially_copyable_v<T>
+bool SaveVec(const char* path, std::span<const T> xs) noexcept {
+    return SaveVecBytes(path, xs.data(), xs.size(), sizeof(T), alignof(T), TypeTag<T>());
+}
+
+// Owns the mapping of a file written by SaveVec. It's the MemResource of the Vec that uses the
+// mapping as buffer, so freeing the buffer unmaps the file. Buffers the Vec grows into come from
+// the default resource.
+class MappedFile : public MemResource {
+public:
+    enum Mode {
+        // Writes to the elements fault, except for those sharing the first page with the header.
+        kReadOnly,
+        // The elements can be modified, changes are private to the process.
+        kCopyOnWrite,
+    };
+
+    MappedFile() noexcept = default;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile() noexcept override;
+
+protected:
+    // Maps the file and sets base to the start of its count elements, or nullptr if there are
+    // none. Returns false with errno set if the file can't be mapped or wasn't written for this
+    // element type.
+    bool Map(const char* path, Mode mode, uint32_t elem_size, uint32_t elem_align, uint64_t type_tag, void** base, uint32_t* count) noexcept;
+
+private:
+    void* do_allocate(size_t bytes, size_t alignment) override;
+    void do_deallocate(void* p, size_t bytes, size_t alignment) override;
+    bool do_is_equal(std::pmr::memory_resource const& other) const noexcept override {
+        return this == &other;
+    }
+    // Copies of the mapped vector go to the heap, they outlive the mapping.
+    MemResource* do_copy_resource() noexcept override { return DefaultResource(); }
+
+    void* mapping_ = nullptr;
+    size_t length_ = 0;
+};
+
+// A Vec whose initial contents are a file written by SaveVec, mapped without deserializing.
+// Code taking Vec<T>& or std::span<T> works on it unchanged. Growing moves the elements to the
+// heap and releases the mapping. Not movable, as the buffer header points at the mapping, and
+// moving it into a plain Vec doesn't compile either. Copies go to the heap.
+template <typename T>
+    requires std::is_trivially_copyable_v<T>
+class MappedVec : public MappedFile, public Vec<T> {
+public:
+    MappedVec() noexcept = default;
+
+    // Replaces the contents with a mapping of path. Returns false with errno set on failure, in
+    // which case the vector is left empty.
+    bool Open(const char* path, Mode mode = kReadOnly) noexcept {
+        this->clear();
+        this->shrink_to_fit();
+        void* base;
+        uint32_t count;
+        if (!Map(path, mode, sizeof(T), alignof(T), TypeTag<T>(), &base, &count)) return false;
+        if (count == 0) return true;
+        this->Header(base) = reinterpret_cast<uintptr_t>(static_cast<MemResource*>(this));
+        this->SetBuffer(base, count, count);
+        return true;
+    }
+};
+
+template <typename T>
+inline constexpr bool is_pinned_vec_v<MappedVec<T>> = true;
+
+}  // namespace gerben
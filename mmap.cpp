@@ -0,0 +1,111 @@
+#include "mmap.hpp"
+
+#include <sys/mman.h>
+
+#include <cstdint>
+#include <new>
+
+namespace gerben {
+
+namespace {
+
+constexpr size_t kPageSize = 4096;
+constexpr size_t kHugePageSize = 2 << 20;
+constexpr size_t kReserveFactor = 16;
+// Bigger requests would overflow the mapping length.
+constexpr size_t kMaxBytes = SIZE_MAX / (2 * kReserveFactor);
+
+size_t RoundUp(size_t x, size_t multiple) {
+    return (x + multiple - 1) / multiple * multiple;
+}
+
+[[noreturn]] void ThrowBadAlloc() {
+#ifdef __cpp_exceptions
+    throw std::bad_alloc();
+#else
+    abort();
+#endif
+}
+
+void Commit(void* p, size_t from, size_t to) {
+    if (to > from && mprotect(static_cast<std::byte*>(p) + from, to - from, PROT_READ | PROT_WRITE) != 0) {
+        ThrowBadAlloc();
+    }
+}
+
+// Gives the pages back to the system and makes the range inaccessible again, like it was
+// before Commit.
+void Decommit(void* p, size_t from, size_t to) {
+    if (to <= from) return;
+    auto start = static_cast<std::byte*>(p) + from;
+    madvise(start, to - from, MADV_DONTNEED);
+    mprotect(start, to - from, PROT_NONE);
+}
+
+// The length of the mapping after p, kept at the end of the page in front of it.
+size_t& MappingLength(void* p) {
+    return static_cast<size_t*>(p)[-1];
+}
+
+}  // namespace
+
+size_t MmapResource::MappingSize(size_t bytes) const noexcept {
+    return std::max(RoundUp(min_reserve_bytes_, kPageSize), RoundUp(bytes, kPageSize) * kReserveFactor);
+}
+
+void* MmapResource::do_allocate(size_t bytes, size_t) {
+    if (bytes > kMaxBytes) ThrowBadAlloc();
+    auto len = MappingSize(bytes);
+    // Over reserve so the allocation can start on a huge page boundary with the length page
+    // in front of it, then trim.
+    auto align = huge_pages_ ? kHugePageSize : kPageSize;
+    auto total = len + align;
+    auto raw = mmap(nullptr, total, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (raw == MAP_FAILED) ThrowBadAlloc();
+    auto start = static_cast<std::byte*>(raw);
+    auto p = reinterpret_cast<std::byte*>(RoundUp(reinterpret_cast<uintptr_t>(start) + kPageSize, align));
+    auto head = p - kPageSize - start;
+    auto tail = start + total - (p + len);
+    if (head) munmap(start, head);
+    if (tail) munmap(p + len, tail);
+    if (huge_pages_) madvise(p, len, MADV_HUGEPAGE);
+    Commit(p - kPageSize, 0, kPageSize + RoundUp(bytes, kPageSize));
+    MappingLength(p) = len;
+    return p;
+}
+
+void MmapResource::do_deallocate(void* p, size_t, size_t) {
+    munmap(static_cast<std::byte*>(p) - kPageSize, kPageSize + MappingLength(p));
+}
+
+bool MmapResource::do_try_expand(void* p, size_t old_bytes, size_t new_bytes, size_t) {
+    if (RoundUp(new_bytes, kPageSize) > MappingLength(p)) return false;
+    Commit(p, RoundUp(old_bytes, kPageSize), RoundUp(new_bytes, kPageSize));
+    return true;
+}
+
+void* MmapResource::do_reallocate(void* p, size_t old_bytes, size_t new_bytes, size_t) {
+    auto old_len = MappingLength(p);
+    auto old_used = RoundUp(old_bytes, kPageSize);
+    auto new_used = RoundUp(new_bytes, kPageSize);
+    if (new_used <= old_len) {
+        // Within the reservation only the committed pages change, a shrink releases its tail.
+        Commit(p, old_used, new_used);
+        Decommit(p, new_used, old_used);
+        return p;
+    }
+    if (new_bytes > kMaxBytes) return nullptr;
+    auto new_len = MappingSize(new_bytes);
+    // mremap can't span mappings of different protection, so commit all of it first and
+    // decommit the part beyond new_bytes after.
+    Commit(p, old_used, old_len);
+    auto m = mremap(static_cast<std::byte*>(p) - kPageSize, kPageSize + old_len, kPageSize + new_len, MREMAP_MAYMOVE);
+    if (m == MAP_FAILED) return nullptr;
+    auto q = static_cast<std::byte*>(m) + kPageSize;
+    MappingLength(q) = new_len;
+    Decommit(q, new_used, new_len);
+    if (huge_pages_) madvise(q, new_len, MADV_HUGEPAGE);
+    return q;
+}
+
+}  // namespace gerben
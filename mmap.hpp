@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+
+#include "vector.hpp"
+
+namespace gerben {
+
+// Resource for very large vectors. Every allocation reserves 16 times its size in address
+// space, but at least min_reserve_bytes, and only commits the pages the capacity covers, so
+// growing within the reservation never copies. Past it, relocatable vectors are moved with
+// mremap, which moves page tables rather than data. The mapping length is kept in a page in
+// front of the allocation. Allocations are 2 MiB aligned and opt into transparent huge pages if
+// asked, to cut TLB misses when scanning. Memory goes back to the system with munmap when the
+// vector is freed.
+class MmapResource : public MemResource {
+public:
+    explicit MmapResource(size_t min_reserve_bytes = size_t{1} << 30, bool huge_pages = true) noexcept
+        : min_reserve_bytes_(min_reserve_bytes), huge_pages_(huge_pages) {}
+
+private:
+    void* do_allocate(size_t bytes, size_t alignment) override;
+    void do_deallocate(void* p, size_t bytes, size_t alignment) override;
+    bool do_try_expand(void* p, size_t old_bytes, size_t new_bytes, size_t alignment) override;
+    void* do_reallocate(void* p, size_t old_bytes, size_t new_bytes, size_t alignment) override;
+    bool do_is_equal(std::pmr::memory_resource const& other) const noexcept override {
+        return this == &other;
+    }
+
+    // The length of a new mapping for an allocation of bytes.
+    size_t MappingSize(size_t bytes) const noexcept;
+
+    size_t min_reserve_bytes_;
+    bool huge_pages_;
+};
+
+}  // namespace gerben
@@ -0,0 +1,108 @@
+#include "numa.hpp"
+
+#include <linux/mempolicy.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <new>
+
+namespace gerben {
+
+namespace {
+
+constexpr size_t kPageSize = 4096;
+
+size_t RoundUp(size_t x, size_t multiple) {
+    return (x + multiple - 1) / multiple * multiple;
+}
+
+[[noreturn]] void ThrowBadAlloc() {
+#ifdef __cpp_exceptions
+    throw std::bad_alloc();
+#else
+    abort();
+#endif
+}
+
+}  // namespace
+
+NumaResource::NumaResource(int node) noexcept : node_(node), mode_(MPOL_PREFERRED), max_node_(0) {
+    constexpr size_t kBits = 8 * sizeof(unsigned long);
+    auto set = [this](int n) {
+        if (n < 0 || size_t(n) >= kMaskWords * kBits) return;
+        mask_[n / kBits] |= 1ul << (n % kBits);
+        max_node_ = std::max<unsigned long>(max_node_, n + 1);
+    };
+    if (node == kInterleaved) {
+        // Only nodes that exist, the kernel rejects bits past its MAX_NUMNODES.
+        mode_ = MPOL_INTERLEAVE;
+        for (int n : OnlineNumaNodes()) set(n);
+    } else {
+        set(node);
+    }
+    // An empty mask has nothing to bind to.
+    if (max_node_ == 0) failed_.store(true, std::memory_order_relaxed);
+}
+
+// Sets the policy before any page is touched, so every page faults in on the right node. glibc
+// has no mbind wrapper, it lives in libnuma, hence the raw syscall.
+void* NumaResource::do_allocate(size_t bytes, size_t) {
+    auto len = RoundUp(bytes, kPageSize);
+    auto p = mmap(nullptr, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (p == MAP_FAILED) ThrowBadAlloc();
+    // maxnode is one more than the number of bits the kernel reads.
+    if (max_node_ != 0 && syscall(SYS_mbind, p, len, mode_, mask_, max_node_ + 1, 0) != 0) {
+        failed_.store(true, std::memory_order_relaxed);
+    }
+    return p;
+}
+
+void NumaResource::do_deallocate(void* p, size_t bytes, size_t) {
+    munmap(p, RoundUp(bytes, kPageSize));
+}
+
+bool NumaResource::do_try_expand(void*, size_t old_bytes, size_t new_bytes, size_t) {
+    return RoundUp(new_bytes, kPageSize) <= RoundUp(old_bytes, kPageSize);
+}
+
+// The mapping keeps its policy when mremap moves or grows it, and so do the pages already on
+// the node.
+void* NumaResource::do_reallocate(void* p, size_t old_bytes, size_t new_bytes, size_t) {
+    auto old_len = RoundUp(old_bytes, kPageSize);
+    auto new_len = RoundUp(new_bytes, kPageSize);
+    if (new_len == old_len) return p;
+    auto q = mremap(p, old_len, new_len, MREMAP_MAYMOVE);
+    return q == MAP_FAILED ? nullptr : q;
+}
+
+Vec<int> OnlineNumaNodes() noexcept {
+    Vec<int> nodes;
+    // A list of ranges like "0-3,8-11".
+    if (auto f = std::fopen("/sys/devices/system/node/online", "r")) {
+        int lo, hi;
+        while (std::fscanf(f, "%d", &lo) == 1) {
+            hi = lo;
+            int c = std::fgetc(f);
+            if (c == '-') {
+                if (std::fscanf(f, "%d", &hi) != 1) break;
+                c = std::fgetc(f);
+            }
+            for (int n = lo; n <= hi; n++) nodes.push_back(n);
+            if (c != ',') break;
+        }
+        std::fclose(f);
+    }
+    if (nodes.empty()) nodes.push_back(0);
+    return nodes;
+}
+
+int CurrentNumaNode() noexcept {
+    unsigned cpu, node;
+    if (syscall(SYS_getcpu, &cpu, &node, nullptr) != 0) return 0;
+    return static_cast<int>(node);
+}
+
+}  // namespace gerben
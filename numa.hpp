@@ -0,0 +1,55 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+
+#include "vector.hpp"
+
+namespace gerben {
+
+// Resource that places every allocation on one NUMA node, or interleaves its pages over all
+// nodes. Each allocation is its own anonymous mapping with an mbind policy, and growth moves it
+// with mremap, which carries the policy along. Since a vector's resource lives in its buffer
+// header, a vector filled and grown by any thread stays where it was put. The policy is
+// preferred rather than strict, so a full node spills over instead of failing. If mbind fails,
+// e.g. for a node that isn't online, the pages are placed as usual and placed() turns false.
+// Meant for large vectors: small allocations each take at least a page.
+class NumaResource : public MemResource {
+public:
+    static constexpr int kInterleaved = -1;
+
+    // Interleaving covers the nodes online at construction.
+    explicit NumaResource(int node) noexcept;
+
+    int node() const noexcept { return node_; }
+    // Whether every allocation so far got its policy.
+    bool placed() const noexcept { return !failed_.load(std::memory_order_relaxed); }
+
+private:
+    void* do_allocate(size_t bytes, size_t alignment) override;
+    void do_deallocate(void* p, size_t bytes, size_t alignment) override;
+    bool do_try_expand(void* p, size_t old_bytes, size_t new_bytes, size_t alignment) override;
+    void* do_reallocate(void* p, size_t old_bytes, size_t new_bytes, size_t alignment) override;
+    bool do_is_equal(std::pmr::memory_resource const& other) const noexcept override {
+        return this == &other;
+    }
+
+    // Room for 1024 nodes, as many as any kernel config allows.
+    static constexpr size_t kMaskWords = 1024 / (8 * sizeof(unsigned long));
+
+    int node_;
+    int mode_;
+    // One more than the highest bit set in mask_, as mbind wants it.
+    unsigned long max_node_;
+    unsigned long mask_[kMaskWords] = {};
+    std::atomic<bool> failed_{false};
+};
+
+// The ids of the NUMA nodes online, ascending and not necessarily dense (e.g. 0 and 2). Just
+// node 0 if the system can't tell.
+Vec<int> OnlineNumaNodes() noexcept;
+
+// The node of the CPU the calling thread is running on.
+int CurrentNumaNode() noexcept;
+
+}  // namespace gerben
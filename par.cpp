@@ -0,0 +1,212 @@
+#include "par.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdlib>
+#include <mutex>
+#include <thread>
+
+#include <pthread.h>
+#include <sched.h>
+
+namespace gerben::par {
+
+namespace {
+
+// [begin, end) of the items a thread has left, packed so the owner taking chunks off the front
+// and thieves taking the back half race on a single CAS.
+struct alignas(64) Slice {
+    std::atomic<uint64_t> range{0};
+};
+
+constexpr uint64_t Pack(uint32_t begin, uint32_t end) { return uint64_t{begin} << 32 | end; }
+constexpr uint32_t Begin(uint64_t range) { return static_cast<uint32_t>(range >> 32); }
+constexpr uint32_t End(uint64_t range) { return static_cast<uint32_t>(range); }
+
+bool TakeFront(Slice& s, uint32_t grain, uint32_t* begin, uint32_t* end) {
+    auto r = s.range.load(std::memory_order_relaxed);
+    for (;;) {
+        auto lo = Begin(r), hi = End(r);
+        if (lo >= hi) return false;
+        auto mid = hi - lo > grain ? lo + grain : hi;
+        if (s.range.compare_exchange_weak(r, Pack(mid, hi), std::memory_order_relaxed)) {
+            *begin = lo;
+            *end = mid;
+            return true;
+        }
+    }
+}
+
+// Leaves the victim at least a chunk, a slice shorter than two chunks is left to its owner.
+bool StealBack(Slice& s, uint32_t grain, uint32_t* begin, uint32_t* end) {
+    auto r = s.range.load(std::memory_order_relaxed);
+    for (;;) {
+        auto lo = Begin(r), hi = End(r);
+        if (lo >= hi || hi - lo < 2 * grain) return false;
+        auto mid = lo + (hi - lo) / 2;
+        if (s.range.compare_exchange_weak(r, Pack(lo, mid), std::memory_order_relaxed)) {
+            *begin = mid;
+            *end = hi;
+            return true;
+        }
+    }
+}
+
+// Set on pool workers and on a caller while it takes part, nested calls then run serially.
+thread_local bool tls_in_parallel = false;
+
+uint32_t ThreadCount() {
+    if (auto env = std::getenv("GERBEN_PAR_THREADS")) {
+        if (auto n = std::strtoul(env, nullptr, 10); n > 0) return static_cast<uint32_t>(n);
+    }
+    return std::max(1u, std::thread::hardware_concurrency());
+}
+
+// Worker i of threads runs on the i'th of threads CPUs spread evenly over the ones the process
+// may use, so a slice index keeps mapping to the same CPU, and node, from one call to the next.
+void PinWorker(uint32_t i, uint32_t threads) {
+    cpu_set_t allowed;
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) return;
+    uint32_t cpus = CPU_COUNT(&allowed);
+    if (cpus == 0) return;
+    uint32_t want = static_cast<uint32_t>(uint64_t{i} * cpus / threads);
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        if (CPU_ISSET(cpu, &allowed) && want-- == 0) {
+            cpu_set_t one;
+            CPU_ZERO(&one);
+            CPU_SET(cpu, &one);
+            pthread_setaffinity_np(pthread_self(), sizeof(one), &one);
+            return;
+        }
+    }
+}
+
+// One call runs at a time: the caller publishes it under mu_, wakes the workers and takes part
+// itself as thread 0. It returns when every item is done and no worker still looks at the call.
+class Pool {
+public:
+    Pool() noexcept : threads_(ThreadCount()), slices_(new Slice[threads_]) {
+        for (uint32_t i = 1; i < threads_; i++) {
+            std::thread([this, i] {
+                PinWorker(i, threads_);
+                Work(i);
+            }).detach();
+        }
+    }
+
+    uint32_t threads() const noexcept { return threads_; }
+
+    void Run(uint32_t n, uint32_t grain, void (*body)(void*, uint32_t, uint32_t), void* ctx, bool steal) noexcept {
+        std::lock_guard submit(submit_mu_);
+        body_ = body;
+        ctx_ = ctx;
+        grain_ = grain;
+        steal_ = steal;
+        done_.store(0, std::memory_order_relaxed);
+        for (uint32_t i = 0; i < threads_; i++) {
+            auto begin = static_cast<uint32_t>(uint64_t{n} * i / threads_);
+            auto end = static_cast<uint32_t>(uint64_t{n} * (i + 1) / threads_);
+            slices_[i].range.store(Pack(begin, end), std::memory_order_relaxed);
+        }
+        {
+            std::lock_guard lock(mu_);
+            generation_++;
+            active_ = true;
+        }
+        wake_.notify_all();
+        tls_in_parallel = true;
+        Participate(0);
+        while (done_.load(std::memory_order_acquire) != n) std::this_thread::yield();
+        tls_in_parallel = false;
+        std::unique_lock lock(mu_);
+        active_ = false;
+        idle_.wait(lock, [this] { return busy_ == 0; });
+    }
+
+private:
+    void Work(uint32_t self) noexcept {
+        tls_in_parallel = true;
+        uint64_t seen = 0;
+        for (;;) {
+            {
+                std::unique_lock lock(mu_);
+                wake_.wait(lock, [&] { return active_ && generation_ != seen; });
+                seen = generation_;
+                busy_++;
+            }
+            Participate(self);
+            std::lock_guard lock(mu_);
+            if (--busy_ == 0) idle_.notify_all();
+        }
+    }
+
+    void Participate(uint32_t self) noexcept {
+        uint32_t begin, end;
+        for (;;) {
+            while (TakeFront(slices_[self], grain_, &begin, &end)) {
+                body_(ctx_, begin, end);
+                done_.fetch_add(end - begin, std::memory_order_release);
+            }
+            if (!steal_ || !Steal(self, &begin, &end)) return;
+            // Our slice is empty so nobody races this store, and the stolen half becomes
+            // stealable in turn.
+            slices_[self].range.store(Pack(begin, end), std::memory_order_relaxed);
+        }
+    }
+
+    bool Steal(uint32_t self, uint32_t* begin, uint32_t* end) noexcept {
+        for (uint32_t k = 1; k < threads_; k++) {
+            if (StealBack(slices_[(self + k) % threads_], grain_, begin, end)) return true;
+        }
+        return false;
+    }
+
+    const uint32_t threads_;
+    Slice* const slices_;
+
+    std::mutex submit_mu_;
+    void (*body_)(void*, uint32_t, uint32_t) = nullptr;
+    void* ctx_ = nullptr;
+    uint32_t grain_ = 1;
+    bool steal_ = true;
+    std::atomic<uint32_t> done_{0};
+
+    std::mutex mu_;
+    std::condition_variable wake_;
+    std::condition_variable idle_;
+    uint64_t generation_ = 0;
+    bool active_ = false;
+    uint32_t busy_ = 0;
+};
+
+// Leaked, workers are parked on the condition variable when the process exits.
+Pool& GetPool() noexcept {
+    static Pool* pool = new Pool;
+    return *pool;
+}
+
+}  // namespace
+
+uint32_t Concurrency() noexcept { return GetPool().threads(); }
+
+void ForRange(uint32_t n, uint32_t grain, void (*body)(void* ctx, uint32_t begin, uint32_t end),
+              void* ctx) noexcept {
+    grain = std::max(grain, 1u);
+    if (n <= grain || tls_in_parallel || Concurrency() == 1) {
+        if (n != 0) body(ctx, 0, n);
+        return;
+    }
+    GetPool().Run(n, grain, body, ctx, true);
+}
+
+void ForSlices(uint32_t n, uint32_t grain, void (*body)(void* ctx, uint32_t begin, uint32_t end),
+               void* ctx) noexcept {
+    grain = std::max(grain, 1u);
+    if (n <= grain || tls_in_parallel || Concurrency() == 1) {
+        if (n != 0) body(ctx, 0, n);
+        return;
+    }
+    GetPool().Run(n, grain, body, ctx, false);
+}
+
+}  // namespace gerben::par
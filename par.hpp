@@ -0,0 +1,201 @@
+#pragma once
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+
+#include "vector.hpp"
+
+// Data parallel operations over the elements of a Vec, run on a process wide work stealing pool
+// whose workers are pinned to CPUs. A call over n items gives thread i the i'th of Concurrency()
+// equal slices to start on, and a thread that runs out steals half of a busy slice. construct
+// and fill don't steal, so every slice of a freshly reserved buffer is first touched, and with
+// the kernel's default policy placed, on the NUMA node of the thread that owns that slice in
+// later passes over the same size. The caller takes part as thread 0 and isn't pinned, so its
+// slice lands wherever it runs.
+namespace gerben::par {
+
+// Number of threads taking part in a parallel call, the pool's workers plus the caller.
+uint32_t Concurrency() noexcept;
+
+// Calls body(ctx, begin, end) on disjoint subranges covering [0, n), in chunks of about grain
+// items, and returns when all have finished. Calls from inside a body run
+// serially on the calling thread, as do calls for at most grain items.
+void ForRange(uint32_t n, uint32_t grain, void (*body)(void* ctx, uint32_t begin, uint32_t end),
+              void* ctx) noexcept;
+
+template <typename F>
+void ForRange(uint32_t n, uint32_t grain, F&& f) noexcept {
+    ForRange(n, grain, [](void* ctx, uint32_t begin, uint32_t end) {
+        (*static_cast<std::remove_reference_t<F>*>(ctx))(begin, end);
+    }, &f);
+}
+
+// As ForRange, but thread i handles exactly the i'th slice of [0, n) and nothing is stolen.
+void ForSlices(uint32_t n, uint32_t grain, void (*body)(void* ctx, uint32_t begin, uint32_t end),
+               void* ctx) noexcept;
+
+template <typename F>
+void ForSlices(uint32_t n, uint32_t grain, F&& f) noexcept {
+    ForSlices(n, grain, [](void* ctx, uint32_t begin, uint32_t end) {
+        (*static_cast<std::remove_reference_t<F>*>(ctx))(begin, end);
+    }, &f);
+}
+
+inline constexpr uint32_t kDefaultGrain = 1 << 14;
+
+// Appends n elements, the i'th constructed from init(i) on the thread owning slice of i.
+template <typename T, GrowthPolicy G, typename F>
+void construct(Vec<T, G>& v, uint32_t n, F init, uint32_t grain = kDefaultGrain) noexcept {
+    v.append_with(n, [&](T* p) {
+        ForSlices(n, grain, [&](uint32_t begin, uint32_t end) {
+            for (uint32_t i = begin; i < end; i++) new (p + i) T(init(i));
+        });
+    });
+}
+
+// Appends n copies of value.
+template <typename T, GrowthPolicy G>
+void fill(Vec<T, G>& v, uint32_t n, const T& value, uint32_t grain = kDefaultGrain) noexcept {
+    par::construct(v, n, [&value](uint32_t) -> const T& { return value; }, grain);
+}
+
+// Calls f(x) for every element.
+template <typename T, GrowthPolicy G, typename F>
+void for_each(Vec<T, G>& v, F f, uint32_t grain = kDefaultGrain) noexcept {
+    auto p = v.data();
+    ForRange(v.size(), grain, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; i++) f(p[i]);
+    });
+}
+
+// Replaces every element x by f(x).
+template <typename T, GrowthPolicy G, typename F>
+void transform(Vec<T, G>& v, F f, uint32_t grain = kDefaultGrain) noexcept {
+    auto p = v.data();
+    ForRange(v.size(), grain, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; i++) p[i] = f(p[i]);
+    });
+}
+
+// Appends f(x) to dst for every element x of src.
+template <typename T, GrowthPolicy G, typename U, GrowthPolicy H, typename F>
+void transform(const Vec<T, G>& src, Vec<U, H>& dst, F f, uint32_t grain = kDefaultGrain) noexcept {
+    auto p = src.data();
+    par::construct(dst, src.size(), [&](uint32_t i) { return f(p[i]); }, grain);
+}
+
+namespace internal {
+
+// Moves n elements to uninitialized dst and destroys the originals.
+template <typename T>
+void RelocateTo(T* dst, T* src, uint32_t n) noexcept {
+    if constexpr (is_relocatable_v<T>) {
+        if (n) std::memcpy(static_cast<void*>(dst), src, size_t{n} * sizeof(T));
+    } else {
+        for (uint32_t i = 0; i < n; i++) {
+            new (dst + i) T(std::move(src[i]));
+            src[i].~T();
+        }
+    }
+}
+
+// How many of the first k elements of the merge of a and b come from a, ties going to a.
+template <typename T, typename Cmp>
+uint32_t CoRank(uint32_t k, const T* a, uint32_t la, const T* b, uint32_t lb, Cmp& cmp) noexcept {
+    uint32_t lo = k > lb ? k - lb : 0;
+    uint32_t hi = std::min(k, la);
+    while (lo < hi) {
+        auto i = lo + (hi - lo) / 2;
+        if (cmp(b[k - i - 1], a[i])) {
+            hi = i;
+        } else {
+            lo = i + 1;
+        }
+    }
+    return lo;
+}
+
+}  // namespace internal
+
+// Sorts Concurrency() (rounded up to a power of two) slices in parallel, then merges
+// neighbouring runs pairwise. Each level of merges is cut into chunks of about grain output
+// elements over all pairs, and every chunk finds where it starts in its two runs by binary
+// search, so the last merge of all n elements is as parallel as the first. Merges move the
+// elements between v and a scratch buffer of n. Not stable.
+template <typename T, GrowthPolicy G, typename Cmp = std::less<>>
+void sort(Vec<T, G>& v, Cmp cmp = {}, uint32_t grain = kDefaultGrain) noexcept {
+    auto n = v.size();
+    auto p = v.data();
+    grain = std::max(grain, 1u);
+    uint32_t runs = 1;
+    while (runs < Concurrency() && uint64_t{runs} * grain < n) runs *= 2;
+    if (runs == 1) {
+        std::sort(p, p + n, cmp);
+        return;
+    }
+    auto bound = [n, runs](uint32_t i) { return static_cast<uint32_t>(uint64_t{n} * i / runs); };
+    ForRange(runs, 1, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; i++) std::sort(p + bound(i), p + bound(i + 1), cmp);
+    });
+
+    // Capacity only, the elements in flight are constructed and destroyed by hand.
+    Vec<T> scratch;
+    scratch.reserve(n);
+    auto chunks = static_cast<uint32_t>((uint64_t{n} + grain - 1) / grain);
+    Vec<uint32_t> splits;
+    splits.resize(chunks);
+    T* src = p;
+    T* dst = scratch.data();
+    for (uint32_t width = 1; width < runs; width *= 2) {
+        // The pair of runs [lo, mid) and [mid, hi) holding output position pos.
+        auto pair_of = [&](uint32_t pos, uint32_t* lo, uint32_t* mid, uint32_t* hi) {
+            uint32_t q = 0;
+            while (bound(2 * width * (q + 1)) <= pos) q++;
+            *lo = bound(2 * width * q);
+            *mid = bound(2 * width * q + width);
+            *hi = bound(2 * width * (q + 1));
+        };
+        // All splits are found before any element moves, the searches read anywhere in the runs.
+        ForRange(chunks, 1, [&](uint32_t begin, uint32_t end) {
+            for (uint32_t c = begin; c < end; c++) {
+                uint32_t lo, mid, hi, pos = c * grain;
+                pair_of(pos, &lo, &mid, &hi);
+                splits[c] = internal::CoRank(pos - lo, src + lo, mid - lo, src + mid, hi - mid, cmp);
+            }
+        });
+        ForRange(chunks, 1, [&](uint32_t begin, uint32_t end) {
+            for (uint32_t c = begin; c < end; c++) {
+                uint32_t pos = c * grain;
+                auto last = static_cast<uint32_t>(std::min<uint64_t>(uint64_t{pos} + grain, n));
+                // A chunk may run past the end of its pair into the start of the next.
+                while (pos < last) {
+                    uint32_t lo, mid, hi;
+                    pair_of(pos, &lo, &mid, &hi);
+                    // Other chunks move the elements around ours, so only look at
+                    // [i, ia) of a and [j, jb) of b.
+                    auto stop = std::min(last, hi);
+                    uint32_t i = pos == c * grain ? splits[c] : 0;
+                    uint32_t j = pos - lo - i;
+                    uint32_t ia = stop == hi ? mid - lo : splits[c + 1];
+                    uint32_t jb = stop - lo - ia;
+                    T* a = src + lo;
+                    T* b = src + mid;
+                    for (; pos < stop; pos++) {
+                        T* x = j < jb && (i == ia || cmp(b[j], a[i])) ? b + j++ : a + i++;
+                        new (dst + pos) T(std::move(*x));
+                        x->~T();
+                    }
+                }
+            }
+        });
+        std::swap(src, dst);
+    }
+    if (src != p) {
+        ForRange(n, grain, [&](uint32_t begin, uint32_t end) {
+            internal::RelocateTo(p + begin, src + begin, end - begin);
+        });
+    }
+}
+
+}  // namespace gerben::par
@@ -0,0 +1,195 @@
+#include "pool.hpp"
+
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <mutex>
+
+namespace gerben {
+
+namespace {
+
+// Class k holds a payload of (1 << k) bytes plus the Vec buffer header.
+constexpr int kMinClass = 3;
+constexpr int kMaxClass = 20;
+constexpr int kNumClasses = kMaxClass + 1;
+constexpr int kLarge = -1;
+constexpr size_t kVecHeader = sizeof(std::max_align_t);
+// Bytes a thread keeps cached per class before returning frees upstream.
+constexpr size_t kMaxCachedBytes = 256 << 10;
+
+constexpr size_t ClassSize(int cls) { return (size_t{1} << cls) + kVecHeader; }
+
+constexpr int ClassOf(size_t bytes) {
+    if (bytes <= ClassSize(kMinClass)) return kMinClass;
+    int cls = std::bit_width(bytes - kVecHeader - 1);
+    return cls <= kMaxClass ? cls : kLarge;
+}
+
+constexpr uint32_t MaxCached(int cls) {
+    return std::clamp<uint32_t>(kMaxCachedBytes >> cls, 4, 1024);
+}
+
+struct FreeNode {
+    FreeNode* next;
+};
+
+struct ThreadCache;
+
+// Precedes every block handed out, so deallocate knows class and owner.
+struct alignas(std::max_align_t) BlockHeader {
+    ThreadCache* owner;  // nullptr for large blocks, which bypass the caches
+    int cls;
+};
+
+struct alignas(64) ThreadCache {
+    FreeNode* free[kNumClasses] = {};
+    uint32_t count[kNumClasses] = {};
+    // Pushed by other threads, popped all at once by the owner so there is no ABA.
+    alignas(64) std::atomic<FreeNode*> remote{nullptr};
+    ThreadCache* next_orphan = nullptr;
+};
+
+inline BlockHeader* HeaderOf(void* p) { return static_cast<BlockHeader*>(p) - 1; }
+
+class Pool : public MemResource {
+public:
+    Pool() noexcept = default;
+
+private:
+    void* do_allocate(size_t bytes, size_t) override {
+        int cls = ClassOf(bytes);
+        auto cache = cls == kLarge ? nullptr : LocalCache();
+        if (cache == nullptr) return NewBlock(nullptr, cls, bytes);
+        if (cache->free[cls] == nullptr) DrainRemote(cache);
+        if (auto node = cache->free[cls]) {
+            cache->free[cls] = node->next;
+            cache->count[cls]--;
+            return node;
+        }
+        return NewBlock(cache, cls, ClassSize(cls));
+    }
+
+    void do_deallocate(void* p, size_t bytes, size_t) override {
+        auto owner = HeaderOf(p)->owner;
+        if (owner == nullptr) {
+            upstream_->deallocate(HeaderOf(p), bytes + sizeof(BlockHeader), alignof(BlockHeader));
+        } else if (owner == tls_cache) {
+            FreeLocal(owner, p);
+        } else {
+            auto node = static_cast<FreeNode*>(p);
+            node->next = owner->remote.load(std::memory_order_relaxed);
+            while (!owner->remote.compare_exchange_weak(node->next, node, std::memory_order_release, std::memory_order_relaxed)) {}
+        }
+    }
+
+    // Blocks are rounded up to their class, so growing within it is free.
+    bool do_try_expand(void* p, size_t, size_t new_bytes, size_t) override {
+        auto h = HeaderOf(p);
+        return h->owner != nullptr && new_bytes <= ClassSize(h->cls);
+    }
+
+    bool do_is_equal(std::pmr::memory_resource const& other) const noexcept override {
+        return this == &other;
+    }
+
+    void* NewBlock(ThreadCache* owner, int cls, size_t bytes) {
+        auto h = static_cast<BlockHeader*>(upstream_->allocate(bytes + sizeof(BlockHeader), alignof(BlockHeader)));
+        h->owner = owner;
+        h->cls = cls;
+        return h + 1;
+    }
+
+    void FreeUpstream(void* p) noexcept {
+        upstream_->deallocate(HeaderOf(p), ClassSize(HeaderOf(p)->cls) + sizeof(BlockHeader), alignof(BlockHeader));
+    }
+
+    void FreeLocal(ThreadCache* cache, void* p) noexcept {
+        int cls = HeaderOf(p)->cls;
+        if (cache->count[cls] >= MaxCached(cls)) return FreeUpstream(p);
+        auto node = static_cast<FreeNode*>(p);
+        node->next = cache->free[cls];
+        cache->free[cls] = node;
+        cache->count[cls]++;
+    }
+
+    void DrainRemote(ThreadCache* cache) noexcept {
+        auto node = cache->remote.exchange(nullptr, std::memory_order_acquire);
+        while (node) {
+            auto next = node->next;
+            FreeLocal(cache, node);
+            node = next;
+        }
+    }
+
+    ThreadCache* LocalCache() {
+        if (tls_cache == nullptr && !tls_exited) {
+            tls_cache = Adopt();
+            tls_owner.pool = this;
+        }
+        return tls_cache;
+    }
+
+    ThreadCache* Adopt() {
+        {
+            std::lock_guard lock(mu_);
+            if (auto cache = orphans_) {
+                orphans_ = cache->next_orphan;
+                return cache;
+            }
+        }
+        return new ThreadCache;
+    }
+
+    // Caches outlive their thread, blocks they own may still be freed remotely. The next thread
+    // to start adopts them.
+    void Orphan(ThreadCache* cache) noexcept {
+        for (int cls = 0; cls < kNumClasses; cls++) {
+            while (auto node = cache->free[cls]) {
+                cache->free[cls] = node->next;
+                FreeUpstream(node);
+            }
+            cache->count[cls] = 0;
+        }
+        auto node = cache->remote.exchange(nullptr, std::memory_order_acquire);
+        while (node) {
+            auto next = node->next;
+            FreeUpstream(node);
+            node = next;
+        }
+        std::lock_guard lock(mu_);
+        cache->next_orphan = orphans_;
+        orphans_ = cache;
+    }
+
+    struct ThreadOwner {
+        Pool* pool = nullptr;
+        ~ThreadOwner() {
+            tls_exited = true;
+            if (pool) pool->Orphan(tls_cache);
+            tls_cache = nullptr;
+        }
+    };
+
+    static thread_local ThreadCache* tls_cache;
+    static thread_local bool tls_exited;
+    static thread_local ThreadOwner tls_owner;
+
+    MemResource* upstream_ = DefaultResource();
+    std::mutex mu_;
+    ThreadCache* orphans_ = nullptr;
+};
+
+constinit thread_local ThreadCache* Pool::tls_cache = nullptr;
+constinit thread_local bool Pool::tls_exited = false;
+thread_local Pool::ThreadOwner Pool::tls_owner;
+
+}  // namespace
+
+MemResource* PoolResource() noexcept {
+    // Never destroyed, buffers may be freed during static destruction.
+    static Pool* pool = new Pool;
+    return pool;
+}
+
+}  // namespace gerben
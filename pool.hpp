@@ -0,0 +1,14 @@
+#pragma once
+
+#include "vector.hpp"
+
+namespace gerben {
+
+// Process wide pool for Vec buffers, segregated by size class with a cache per thread. Since
+// GrowOutline doubles, requests are a power-of-two payload plus the Vec buffer header, and the
+// classes are shaped to fit exactly that. Steady state allocation and deallocation never
+// leaves the calling thread. A buffer freed by another thread than the one that allocated it is
+// pushed onto the owning cache's lock free remote list and recycled from there.
+MemResource* PoolResource() noexcept;
+
+}  // namespace gerben
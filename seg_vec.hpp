@@ -0,0 +1,159 @@
+#pragma once
+
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <utility>
+
+#include "vector.hpp"
+
+namespace gerben {
+
+// A vector whose elements never move, so addresses stay stable and growing never copies. It is
+// a fixed table of Vec chunks that double in size, chunk c holding kBase << c elements starting
+// at index kBase * (2^c - 1), which makes indexing a bit_width and a subtraction. Chunks are
+// reserved to their exact size when first needed and then never grow, so the worst case append
+// is one allocation from the resource, not a copy of everything appended before.
+template <IsNoThrowMoveConstructible T>
+class SegVec {
+    // The first chunk is around 512 bytes.
+    static constexpr uint32_t kBaseShift = std::max(1, 10 - static_cast<int>(std::bit_width(sizeof(T))));
+    static constexpr uint64_t kBase = uint64_t{1} << kBaseShift;
+    static constexpr uint32_t kMaxChunks = 33 - kBaseShift;
+
+    template <typename V, typename R>
+    class Iter {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+        using reference = R&;
+        using pointer = R*;
+
+        Iter() noexcept = default;
+        Iter(V* v, uint32_t idx) noexcept : v_(v), idx_(idx) {}
+        R& operator*() const noexcept { return (*v_)[idx_]; }
+        R* operator->() const noexcept { return &(*v_)[idx_]; }
+        Iter& operator++() noexcept {
+            idx_++;
+            return *this;
+        }
+        Iter operator++(int) noexcept { return Iter(v_, idx_++); }
+        bool operator==(const Iter& other) const noexcept { return idx_ == other.idx_; }
+
+    private:
+        V* v_ = nullptr;
+        uint32_t idx_ = 0;
+    };
+
+public:
+    using iterator = Iter<SegVec, T>;
+    using const_iterator = Iter<const SegVec, const T>;
+
+    SegVec() noexcept = default;
+    explicit SegVec(MemResource* mr) noexcept {
+        for (auto& c : chunks_) c = Vec<T>(mr);
+    }
+    SegVec(SegVec&& other) noexcept { swap(other); }
+    SegVec& operator=(SegVec&& other) noexcept {
+        swap(other);
+        return *this;
+    }
+    void swap(SegVec& other) noexcept {
+        for (uint32_t c = 0; c < kMaxChunks; c++) chunks_[c].swap(other.chunks_[c]);
+        std::swap(size_, other.size_);
+    }
+
+    uint32_t size() const noexcept { return size_; }
+    bool empty() const noexcept { return size_ == 0; }
+
+    T& operator[](uint32_t idx) noexcept {
+        auto c = ChunkOf(idx);
+        return chunks_[c][idx - ChunkStart(c)];
+    }
+    T const& operator[](uint32_t idx) const noexcept {
+        auto c = ChunkOf(idx);
+        return chunks_[c][idx - ChunkStart(c)];
+    }
+    T& at(uint32_t idx) {
+        if (idx >= size_) ThrowOutOfRange();
+        return (*this)[idx];
+    }
+    T const& at(uint32_t idx) const {
+        if (idx >= size_) ThrowOutOfRange();
+        return (*this)[idx];
+    }
+    T& front() noexcept { return chunks_[0][0]; }
+    T const& front() const noexcept { return chunks_[0][0]; }
+    T& back() noexcept { return (*this)[size_ - 1]; }
+    T const& back() const noexcept { return (*this)[size_ - 1]; }
+
+    iterator begin() noexcept { return {this, 0}; }
+    iterator end() noexcept { return {this, size_}; }
+    const_iterator begin() const noexcept { return {this, 0}; }
+    const_iterator end() const noexcept { return {this, size_}; }
+
+    template <typename... Args>
+    T& emplace_back(Args&&... args) noexcept {
+        auto& chunk = chunks_[ChunkOf(size_)];
+        if (chunk.size() == chunk.capacity()) [[unlikely]] chunk.reserve(ChunkLen(ChunkOf(size_)));
+        size_++;
+        return chunk.emplace_back(std::forward<Args>(args)...);
+    }
+    void push_back(const T& x) noexcept { emplace_back(x); }
+    void push_back(T&& x) noexcept { emplace_back(std::move(x)); }
+
+    T pop_back() noexcept {
+        size_--;
+        return chunks_[ChunkOf(size_)].pop_back();
+    }
+
+    // Allocates the chunks needed to hold n elements, so appends up to there don't allocate.
+    void reserve(uint32_t n) noexcept {
+        for (uint32_t c = 0; c < kMaxChunks && n > ChunkStart(c); c++) chunks_[c].reserve(ChunkLen(c));
+    }
+
+    // Destroys the elements but keeps the chunks.
+    void clear() noexcept {
+        for (auto& c : chunks_) c.clear();
+        size_ = 0;
+    }
+
+    // Moves all elements into one contiguous Vec, with a memcpy per chunk for relocatable T,
+    // and leaves this empty. The chunks are freed.
+    Vec<T> flatten() noexcept {
+        Vec<T> v(chunks_[0].Resource());
+        v.append_with(size_, [this](T* dst) {
+            for (auto& c : chunks_) {
+                auto k = c.size();
+                if constexpr (is_relocatable_v<T>) {
+                    if (k != 0) std::memcpy(static_cast<void*>(dst), c.data(), size_t{k} * sizeof(T));
+                    c.SetSize(0);
+                } else {
+                    std::uninitialized_move(c.begin(), c.end(), dst);
+                    c.clear();
+                }
+                dst += k;
+                c.shrink_to_fit();
+            }
+        });
+        size_ = 0;
+        return v;
+    }
+
+private:
+    static constexpr uint32_t ChunkOf(uint64_t idx) noexcept { return std::bit_width(idx / kBase + 1) - 1; }
+    static constexpr uint64_t ChunkStart(uint32_t c) noexcept { return kBase * ((uint64_t{1} << c) - 1); }
+    static constexpr uint32_t ChunkLen(uint32_t c) noexcept {
+        return static_cast<uint32_t>(std::min<uint64_t>(kBase << c, UINT32_MAX - ChunkStart(c) + 1));
+    }
+
+    Vec<T> chunks_[kMaxChunks];
+    uint32_t size_ = 0;
+};
+
+template <typename T>
+inline constexpr bool is_known_relocatable_v<SegVec<T>> = true;
+
+}  // namespace gerben
@@ -0,0 +1,420 @@
+#include "simd.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <climits>
+#include <type_traits>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define GERBEN_SIMD_X86 1
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#define GERBEN_SIMD_NEON 1
+#endif
+
+namespace gerben::simd {
+
+namespace {
+
+// Vectors hold int32_t or float lanes. uint32_t is loaded with the sign bit flipped, which
+// maps unsigned order onto signed order, so only signed compares and min/max are needed.
+constexpr uint32_t kBias = 0x80000000u;
+
+template <typename U>
+using LaneOf = std::conditional_t<std::is_same_v<U, float>, float, int32_t>;
+
+template <typename U>
+U FromLane(LaneOf<U> x) {
+    if constexpr (std::is_same_v<U, uint32_t>) {
+        return static_cast<uint32_t>(x) ^ kBias;
+    } else {
+        return x;
+    }
+}
+
+template <Cmp kOp, typename U>
+bool Match(U x, U v) {
+    if constexpr (kOp == Cmp::kEq) return x == v;
+    if constexpr (kOp == Cmp::kNe) return x != v;
+    if constexpr (kOp == Cmp::kLt) return x < v;
+    if constexpr (kOp == Cmp::kLe) return x <= v;
+    if constexpr (kOp == Cmp::kGt) return x > v;
+    if constexpr (kOp == Cmp::kGe) return x >= v;
+}
+
+// Turns the runtime comparison into a template argument, so the kernels don't branch on it.
+template <typename F>
+auto WithCmp(Cmp op, F f) {
+    switch (op) {
+        case Cmp::kEq: return f.template operator()<Cmp::kEq>();
+        case Cmp::kNe: return f.template operator()<Cmp::kNe>();
+        case Cmp::kLt: return f.template operator()<Cmp::kLt>();
+        case Cmp::kLe: return f.template operator()<Cmp::kLe>();
+        case Cmp::kGt: return f.template operator()<Cmp::kGt>();
+        case Cmp::kGe: break;
+    }
+    return f.template operator()<Cmp::kGe>();
+}
+
+template <typename U>
+struct Kernels {
+    uint32_t (*find)(const U*, uint32_t, U, Cmp);
+    uint32_t (*count)(const U*, uint32_t, U, Cmp);
+    std::pair<U, U> (*min_max)(const U*, uint32_t);
+    U (*accumulate)(const U*, uint32_t, U);
+    uint32_t (*compact)(U*, uint32_t, U, Cmp);
+};
+
+// One lane "vectors", the fallback when there is nothing better.
+namespace scalar {
+
+constexpr uint32_t kLanes = 1;
+using VI = int32_t;
+using VF = float;
+
+inline VI Load(const int32_t* p) { return *p; }
+inline VI Load(const uint32_t* p) { return static_cast<int32_t>(*p ^ kBias); }
+inline VF Load(const float* p) { return *p; }
+inline VI Splat(int32_t x) { return x; }
+inline VI Splat(uint32_t x) { return static_cast<int32_t>(x ^ kBias); }
+inline VF Splat(float x) { return x; }
+template <Cmp kOp, typename V>
+uint32_t CmpMask(V a, V b) { return Match<kOp>(a, b); }
+template <typename V>
+V Min(V a, V b) { return std::min(a, b); }
+template <typename V>
+V Max(V a, V b) { return std::max(a, b); }
+inline VI Add(VI a, VI b) { return static_cast<int32_t>(static_cast<uint32_t>(a) + static_cast<uint32_t>(b)); }
+inline VF Add(VF a, VF b) { return a + b; }
+template <typename V>
+void Store(V* p, V v) { *p = v; }
+template <typename V>
+uint32_t CompressStore(V* out, V v, uint32_t keep) {
+    *out = v;
+    return keep;
+}
+
+#include "simd_kernels.inc"
+
+}  // namespace scalar
+
+#if defined(GERBEN_SIMD_X86)
+
+// Index vectors for vpermd, entry m moves the lanes set in m to the front.
+struct PermuteTable {
+    alignas(32) uint32_t idx[256][8];
+};
+
+constexpr PermuteTable MakePermuteTable() {
+    PermuteTable t{};
+    for (uint32_t m = 0; m < 256; m++) {
+        uint32_t k = 0;
+        for (uint32_t lane = 0; lane < 8; lane++) {
+            if (m & (1u << lane)) t.idx[m][k++] = lane;
+        }
+    }
+    return t;
+}
+
+constexpr PermuteTable kPermute = MakePermuteTable();
+
+#ifdef __clang__
+#pragma clang attribute push(__attribute__((target("avx2,bmi,popcnt"))), apply_to = function)
+#else
+#pragma GCC push_options
+#pragma GCC target("avx2,bmi,popcnt")
+#endif
+
+namespace avx2 {
+
+constexpr uint32_t kLanes = 8;
+using VI = __m256i;
+using VF = __m256;
+
+inline VI Load(const int32_t* p) { return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)); }
+inline VI Load(const uint32_t* p) {
+    return _mm256_xor_si256(Load(reinterpret_cast<const int32_t*>(p)), _mm256_set1_epi32(INT32_MIN));
+}
+inline VF Load(const float* p) { return _mm256_loadu_ps(p); }
+inline VI Splat(int32_t x) { return _mm256_set1_epi32(x); }
+inline VI Splat(uint32_t x) { return _mm256_set1_epi32(static_cast<int32_t>(x ^ kBias)); }
+inline VF Splat(float x) { return _mm256_set1_ps(x); }
+
+template <Cmp kOp>
+uint32_t CmpMask(VI a, VI b) {
+    auto ones = _mm256_set1_epi32(-1);
+    VI m;
+    if constexpr (kOp == Cmp::kEq) m = _mm256_cmpeq_epi32(a, b);
+    if constexpr (kOp == Cmp::kNe) m = _mm256_xor_si256(_mm256_cmpeq_epi32(a, b), ones);
+    if constexpr (kOp == Cmp::kLt) m = _mm256_cmpgt_epi32(b, a);
+    if constexpr (kOp == Cmp::kLe) m = _mm256_xor_si256(_mm256_cmpgt_epi32(a, b), ones);
+    if constexpr (kOp == Cmp::kGt) m = _mm256_cmpgt_epi32(a, b);
+    if constexpr (kOp == Cmp::kGe) m = _mm256_xor_si256(_mm256_cmpgt_epi32(b, a), ones);
+    return _mm256_movemask_ps(_mm256_castsi256_ps(m));
+}
+
+template <Cmp kOp>
+uint32_t CmpMask(VF a, VF b) {
+    constexpr int kPred = kOp == Cmp::kEq ? _CMP_EQ_OQ
+                        : kOp == Cmp::kNe ? _CMP_NEQ_UQ
+                        : kOp == Cmp::kLt ? _CMP_LT_OQ
+                        : kOp == Cmp::kLe ? _CMP_LE_OQ
+                        : kOp == Cmp::kGt ? _CMP_GT_OQ
+                                          : _CMP_GE_OQ;
+    return _mm256_movemask_ps(_mm256_cmp_ps(a, b, kPred));
+}
+
+inline VI Min(VI a, VI b) { return _mm256_min_epi32(a, b); }
+inline VF Min(VF a, VF b) { return _mm256_min_ps(a, b); }
+inline VI Max(VI a, VI b) { return _mm256_max_epi32(a, b); }
+inline VF Max(VF a, VF b) { return _mm256_max_ps(a, b); }
+inline VI Add(VI a, VI b) { return _mm256_add_epi32(a, b); }
+inline VF Add(VF a, VF b) { return _mm256_add_ps(a, b); }
+inline void Store(int32_t* p, VI v) { _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), v); }
+inline void Store(float* p, VF v) { _mm256_storeu_ps(p, v); }
+
+inline uint32_t CompressStore(int32_t* out, VI v, uint32_t keep) {
+    auto idx = _mm256_load_si256(reinterpret_cast<const __m256i*>(kPermute.idx[keep]));
+    Store(out, _mm256_permutevar8x32_epi32(v, idx));
+    return std::popcount(keep);
+}
+
+inline uint32_t CompressStore(float* out, VF v, uint32_t keep) {
+    auto idx = _mm256_load_si256(reinterpret_cast<const __m256i*>(kPermute.idx[keep]));
+    Store(out, _mm256_permutevar8x32_ps(v, idx));
+    return std::popcount(keep);
+}
+
+#include "simd_kernels.inc"
+
+}  // namespace avx2
+
+#ifdef __clang__
+#pragma clang attribute pop
+#pragma clang attribute push(__attribute__((target("avx512f,avx2,bmi,popcnt"))), apply_to = function)
+#else
+#pragma GCC pop_options
+#pragma GCC push_options
+#pragma GCC target("avx512f,avx2,bmi,popcnt")
+#endif
+
+namespace avx512 {
+
+constexpr uint32_t kLanes = 16;
+using VI = __m512i;
+using VF = __m512;
+
+inline VI Load(const int32_t* p) { return _mm512_loadu_si512(p); }
+inline VI Load(const uint32_t* p) { return _mm512_xor_si512(_mm512_loadu_si512(p), _mm512_set1_epi32(INT32_MIN)); }
+inline VF Load(const float* p) { return _mm512_loadu_ps(p); }
+inline VI Splat(int32_t x) { return _mm512_set1_epi32(x); }
+inline VI Splat(uint32_t x) { return _mm512_set1_epi32(static_cast<int32_t>(x ^ kBias)); }
+inline VF Splat(float x) { return _mm512_set1_ps(x); }
+
+template <Cmp kOp>
+uint32_t CmpMask(VI a, VI b) {
+    constexpr int kPred = kOp == Cmp::kEq ? _MM_CMPINT_EQ
+                        : kOp == Cmp::kNe ? _MM_CMPINT_NE
+                        : kOp == Cmp::kLt ? _MM_CMPINT_LT
+                        : kOp == Cmp::kLe ? _MM_CMPINT_LE
+                        : kOp == Cmp::kGt ? _MM_CMPINT_NLE
+                                          : _MM_CMPINT_NLT;
+    return _mm512_cmp_epi32_mask(a, b, kPred);
+}
+
+template <Cmp kOp>
+uint32_t CmpMask(VF a, VF b) {
+    constexpr int kPred = kOp == Cmp::kEq ? _CMP_EQ_OQ
+                        : kOp == Cmp::kNe ? _CMP_NEQ_UQ
+                        : kOp == Cmp::kLt ? _CMP_LT_OQ
+                        : kOp == Cmp::kLe ? _CMP_LE_OQ
+                        : kOp == Cmp::kGt ? _CMP_GT_OQ
+                                          : _CMP_GE_OQ;
+    return _mm512_cmp_ps_mask(a, b, kPred);
+}
+
+// The masked forms, GCC 12 warns about the _mm512_undefined passthrough of the plain ones.
+inline VI Min(VI a, VI b) { return _mm512_mask_min_epi32(a, 0xffff, a, b); }
+inline VF Min(VF a, VF b) { return _mm512_mask_min_ps(a, 0xffff, a, b); }
+inline VI Max(VI a, VI b) { return _mm512_mask_max_epi32(a, 0xffff, a, b); }
+inline VF Max(VF a, VF b) { return _mm512_mask_max_ps(a, 0xffff, a, b); }
+inline VI Add(VI a, VI b) { return _mm512_add_epi32(a, b); }
+inline VF Add(VF a, VF b) { return _mm512_add_ps(a, b); }
+inline void Store(int32_t* p, VI v) { _mm512_storeu_si512(p, v); }
+inline void Store(float* p, VF v) { _mm512_storeu_ps(p, v); }
+
+// Compress in a register and store the whole vector, vpcompressd with a memory operand is
+// microcoded on some cores.
+inline uint32_t CompressStore(int32_t* out, VI v, uint32_t keep) {
+    Store(out, _mm512_maskz_compress_epi32(static_cast<__mmask16>(keep), v));
+    return std::popcount(keep);
+}
+
+inline uint32_t CompressStore(float* out, VF v, uint32_t keep) {
+    Store(out, _mm512_maskz_compress_ps(static_cast<__mmask16>(keep), v));
+    return std::popcount(keep);
+}
+
+#include "simd_kernels.inc"
+
+}  // namespace avx512
+
+#ifdef __clang__
+#pragma clang attribute pop
+#else
+#pragma GCC pop_options
+#endif
+
+#elif defined(GERBEN_SIMD_NEON)
+
+// tbl byte indices, entry m moves the lanes set in m to the front.
+struct ShuffleTable {
+    alignas(16) uint8_t idx[16][16];
+};
+
+constexpr ShuffleTable MakeShuffleTable() {
+    ShuffleTable t{};
+    for (uint32_t m = 0; m < 16; m++) {
+        uint32_t k = 0;
+        for (uint32_t lane = 0; lane < 4; lane++) {
+            if (!(m & (1u << lane))) continue;
+            for (uint32_t b = 0; b < 4; b++) t.idx[m][4 * k + b] = static_cast<uint8_t>(4 * lane + b);
+            k++;
+        }
+    }
+    return t;
+}
+
+constexpr ShuffleTable kShuffle = MakeShuffleTable();
+
+namespace neon {
+
+constexpr uint32_t kLanes = 4;
+using VI = int32x4_t;
+using VF = float32x4_t;
+
+inline VI Load(const int32_t* p) { return vld1q_s32(p); }
+inline VI Load(const uint32_t* p) {
+    return veorq_s32(vld1q_s32(reinterpret_cast<const int32_t*>(p)), vdupq_n_s32(INT32_MIN));
+}
+inline VF Load(const float* p) { return vld1q_f32(p); }
+inline VI Splat(int32_t x) { return vdupq_n_s32(x); }
+inline VI Splat(uint32_t x) { return vdupq_n_s32(static_cast<int32_t>(x ^ kBias)); }
+inline VF Splat(float x) { return vdupq_n_f32(x); }
+
+inline uint32_t MoveMask(uint32x4_t m) {
+    const uint32x4_t kBits = {1, 2, 4, 8};
+    return vaddvq_u32(vandq_u32(m, kBits));
+}
+
+template <Cmp kOp>
+uint32_t CmpMask(VI a, VI b) {
+    uint32x4_t m;
+    if constexpr (kOp == Cmp::kEq) m = vceqq_s32(a, b);
+    if constexpr (kOp == Cmp::kNe) m = vmvnq_u32(vceqq_s32(a, b));
+    if constexpr (kOp == Cmp::kLt) m = vcltq_s32(a, b);
+    if constexpr (kOp == Cmp::kLe) m = vcleq_s32(a, b);
+    if constexpr (kOp == Cmp::kGt) m = vcgtq_s32(a, b);
+    if constexpr (kOp == Cmp::kGe) m = vcgeq_s32(a, b);
+    return MoveMask(m);
+}
+
+template <Cmp kOp>
+uint32_t CmpMask(VF a, VF b) {
+    uint32x4_t m;
+    if constexpr (kOp == Cmp::kEq) m = vceqq_f32(a, b);
+    if constexpr (kOp == Cmp::kNe) m = vmvnq_u32(vceqq_f32(a, b));
+    if constexpr (kOp == Cmp::kLt) m = vcltq_f32(a, b);
+    if constexpr (kOp == Cmp::kLe) m = vcleq_f32(a, b);
+    if constexpr (kOp == Cmp::kGt) m = vcgtq_f32(a, b);
+    if constexpr (kOp == Cmp::kGe) m = vcgeq_f32(a, b);
+    return MoveMask(m);
+}
+
+inline VI Min(VI a, VI b) { return vminq_s32(a, b); }
+inline VF Min(VF a, VF b) { return vminq_f32(a, b); }
+inline VI Max(VI a, VI b) { return vmaxq_s32(a, b); }
+inline VF Max(VF a, VF b) { return vmaxq_f32(a, b); }
+inline VI Add(VI a, VI b) { return vaddq_s32(a, b); }
+inline VF Add(VF a, VF b) { return vaddq_f32(a, b); }
+inline void Store(int32_t* p, VI v) { vst1q_s32(p, v); }
+inline void Store(float* p, VF v) { vst1q_f32(p, v); }
+
+inline uint32_t CompressStore(int32_t* out, VI v, uint32_t keep) {
+    auto r = vqtbl1q_u8(vreinterpretq_u8_s32(v), vld1q_u8(kShuffle.idx[keep]));
+    vst1q_u8(reinterpret_cast<uint8_t*>(out), r);
+    return std::popcount(keep);
+}
+
+inline uint32_t CompressStore(float* out, VF v, uint32_t keep) {
+    auto r = vqtbl1q_u8(vreinterpretq_u8_f32(v), vld1q_u8(kShuffle.idx[keep]));
+    vst1q_u8(reinterpret_cast<uint8_t*>(out), r);
+    return std::popcount(keep);
+}
+
+#include "simd_kernels.inc"
+
+}  // namespace neon
+
+#endif
+
+// Picked once per lane type, NEON is part of the aarch64 baseline so only x86 asks cpuid.
+template <typename U>
+const Kernels<U>& Dispatch() noexcept {
+    static const Kernels<U> kernels = [] {
+#if defined(GERBEN_SIMD_X86)
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx512f")) return avx512::kKernels<U>;
+        if (__builtin_cpu_supports("avx2")) return avx2::kKernels<U>;
+        return scalar::kKernels<U>;
+#elif defined(GERBEN_SIMD_NEON)
+        return neon::kKernels<U>;
+#else
+        return scalar::kKernels<U>;
+#endif
+    }();
+    return kernels;
+}
+
+}  // namespace
+
+template <Lane T>
+uint32_t find(std::span<const T> xs, T value, Cmp op) noexcept {
+    return Dispatch<T>().find(xs.data(), xs.size(), value, op);
+}
+
+template <Lane T>
+uint32_t count(std::span<const T> xs, T value, Cmp op) noexcept {
+    return Dispatch<T>().count(xs.data(), xs.size(), value, op);
+}
+
+template <Lane T>
+std::pair<T, T> min_max(std::span<const T> xs) noexcept {
+    return Dispatch<T>().min_max(xs.data(), xs.size());
+}
+
+template <Lane T>
+T accumulate(std::span<const T> xs, T init) noexcept {
+    return Dispatch<T>().accumulate(xs.data(), xs.size(), init);
+}
+
+template <Lane T>
+uint32_t compact(std::span<T> xs, T value, Cmp op) noexcept {
+    return Dispatch<T>().compact(xs.data(), xs.size(), value, op);
+}
+
+#define GERBEN_SIMD_INSTANTIATE(T)                                           \
+    template uint32_t find(std::span<const T>, T, Cmp) noexcept;             \
+    template uint32_t count(std::span<const T>, T, Cmp) noexcept;            \
+    template std::pair<T, T> min_max(std::span<const T>) noexcept;           \
+    template T accumulate(std::span<const T>, T) noexcept;                   \
+    template uint32_t compact(std::span<T>, T, Cmp) noexcept;
+
+GERBEN_SIMD_INSTANTIATE(int32_t)
+GERBEN_SIMD_INSTANTIATE(uint32_t)
+GERBEN_SIMD_INSTANTIATE(float)
+
+#undef GERBEN_SIMD_INSTANTIATE
+
+}  // namespace gerben::simd
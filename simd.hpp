@@ -0,0 +1,94 @@
+#pragma once
+
+#include <concepts>
+#include <span>
+#include <utility>
+
+#include "vector.hpp"
+
+// Bulk algorithms over contiguous int32_t, uint32_t and float, vectorized with AVX2 or AVX-512
+// on x86 (picked at runtime from cpuid) and NEON on aarch64, with a scalar fallback otherwise.
+// The std algorithms over Vec::begin()/end() frequently stay scalar, since the loop bound is
+// reloaded through `this` after every store, these kernels only ever see a pointer and a count.
+namespace gerben::simd {
+
+template <typename T>
+concept Lane = std::same_as<T, int32_t> || std::same_as<T, uint32_t> || std::same_as<T, float>;
+
+// Element wise comparison `x <op> value`. For floats the comparisons behave as the scalar
+// operators do, so a NaN only matches kNe.
+enum class Cmp : uint8_t { kEq, kNe, kLt, kLe, kGt, kGe };
+
+// Index of the first element for which `x <op> value` holds, or xs.size() if none does.
+template <Lane T>
+uint32_t find(std::span<const T> xs, T value, Cmp op = Cmp::kEq) noexcept;
+
+// Number of elements for which `x <op> value` holds.
+template <Lane T>
+uint32_t count(std::span<const T> xs, T value, Cmp op = Cmp::kEq) noexcept;
+
+// Smallest and largest element, xs must be non empty. NaNs give unspecified results.
+template <Lane T>
+std::pair<T, T> min_max(std::span<const T> xs) noexcept;
+
+// init plus the sum of all elements. Integer sums wrap, float sums are reassociated across
+// the vector lanes and may round differently from a left fold.
+template <Lane T>
+T accumulate(std::span<const T> xs, T init = {}) noexcept;
+
+// Stream compaction, moves the elements for which `x <op> value` does NOT hold to the front
+// preserving their order and returns how many there are. The tail is left unspecified.
+template <Lane T>
+uint32_t compact(std::span<T> xs, T value, Cmp op) noexcept;
+
+template <Lane T, GrowthPolicy G>
+uint32_t find(const Vec<T, G>& v, T value, Cmp op = Cmp::kEq) noexcept {
+    return simd::find(std::span<const T>(v.data(), v.size()), value, op);
+}
+
+template <Lane T, GrowthPolicy G>
+uint32_t count(const Vec<T, G>& v, T value, Cmp op = Cmp::kEq) noexcept {
+    return simd::count(std::span<const T>(v.data(), v.size()), value, op);
+}
+
+template <Lane T, GrowthPolicy G>
+std::pair<T, T> min_max(const Vec<T, G>& v) noexcept {
+    return simd::min_max(std::span<const T>(v.data(), v.size()));
+}
+
+template <Lane T, GrowthPolicy G>
+T accumulate(const Vec<T, G>& v, T init = {}) noexcept {
+    return simd::accumulate(std::span<const T>(v.data(), v.size()), init);
+}
+
+// The predicate `x <op> value`. Vec::erase_if picks up its Compact member and runs compact()
+// instead of calling it per element.
+template <Lane T>
+struct Compare {
+    Cmp op;
+    T value;
+
+    bool operator()(T x) const noexcept {
+        switch (op) {
+            case Cmp::kEq: return x == value;
+            case Cmp::kNe: return x != value;
+            case Cmp::kLt: return x < value;
+            case Cmp::kLe: return x <= value;
+            case Cmp::kGt: return x > value;
+            case Cmp::kGe: break;
+        }
+        return x >= value;
+    }
+    uint32_t Compact(T* p, uint32_t n) const noexcept {
+        return simd::compact(std::span<T>(p, n), value, op);
+    }
+};
+
+// Removes the elements for which `x <op> value` holds, the size is updated once at the end.
+// Returns the number of elements removed.
+template <Lane T, GrowthPolicy G>
+uint32_t erase_if(Vec<T, G>& v, T value, Cmp op) noexcept {
+    return v.erase_if(Compare<T>{op, value});
+}
+
+}  // namespace gerben::simd
@@ -0,0 +1,30 @@
+#include "soa_vec.hpp"
+
+#include <cstring>
+
+namespace gerben {
+
+std::pair<void*, uint32_t> SoABase::GrowColumnsOutline(void* base_or_mr, uint32_t size, uint32_t cap,
+                                                       const uint32_t* sizes, uint32_t ncols,
+                                                       uint32_t newcap) noexcept {
+    uint32_t row_bytes = 0;
+    for (uint32_t i = 0; i < ncols; i++) row_bytes += sizes[i];
+    uint64_t rows = std::max<uint64_t>({newcap, uint64_t{cap} * 2, kRowQuantum});
+    rows = std::min<uint64_t>((rows + kRowQuantum - 1) / kRowQuantum * kRowQuantum, UINT32_MAX / kRowQuantum * kRowQuantum);
+    auto mr = cap == 0 ? base_or_mr : reinterpret_cast<void*>(Header(base_or_mr));
+    // The default policy doesn't round, so the buffer has exactly the rows asked for.
+    auto [base, newrows] = GrowOutline(mr, 0, 0, row_bytes, nullptr, static_cast<uint32_t>(rows), GrowthPolicy{});
+    if (cap != 0) {
+        auto from = static_cast<std::byte*>(base_or_mr);
+        auto to = static_cast<std::byte*>(base);
+        for (uint32_t i = 0; i < ncols; i++) {
+            std::memcpy(to, from, size_t{size} * sizes[i]);
+            from += size_t{cap} * sizes[i];
+            to += size_t{newrows} * sizes[i];
+        }
+        FreeOutline(base_or_mr, size_t{cap} * row_bytes);
+    }
+    return {base, newrows};
+}
+
+}  // namespace gerben
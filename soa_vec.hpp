@@ -0,0 +1,160 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "vector.hpp"
+
+namespace gerben {
+
+// The type erased part of SoAVec. The buffer is a regular Vec buffer of capacity rows of
+// sum(sizeof(Fields)) bytes each, with the columns back to back: column i starts at
+// capacity * (sizeof of the fields before i). Capacity is kept a multiple of kRowQuantum, so
+// every column starts 16 byte aligned.
+class SoABase : public VecBase {
+protected:
+    static constexpr uint32_t kRowQuantum = 16;
+
+    constexpr SoABase() noexcept = default;
+    constexpr SoABase(MemResource* mr) noexcept : VecBase(mr) {}
+
+    // Grows to at least newcap rows, at least doubling, and moves every column to its place in
+    // the new buffer. Takes the members by value and returns the new buffer, so like Vec's
+    // growth it doesn't let `this` escape.
+    static std::pair<void*, uint32_t> GrowColumnsOutline(void* base_or_mr, uint32_t size, uint32_t cap,
+                                                         const uint32_t* sizes, uint32_t ncols,
+                                                         uint32_t newcap) noexcept;
+    static void FreeColumnsOutline(void* base, size_t bytes) noexcept { FreeOutline(base, bytes); }
+};
+
+// A vector of rows stored as one column per field, so a scan over one or two fields only pulls
+// those through the cache. All columns share one allocation and one size and capacity, and all
+// of them grow in a single outlined call. Fields must be relocatable, since columns are moved
+// with memcpy.
+template <typename... Fields>
+class SoAVec : public SoABase {
+    static_assert(sizeof...(Fields) > 0);
+    static_assert((is_relocatable_v<Fields> && ...));
+    static_assert(((alignof(Fields) <= 16) && ...));
+
+    static constexpr uint32_t kCols = sizeof...(Fields);
+    static constexpr uint32_t kSizes[kCols] = {sizeof(Fields)...};
+    static constexpr size_t kRowBytes = (sizeof(Fields) + ...);
+
+    template <size_t I>
+    static constexpr uint32_t kPrefix = [] {
+        uint32_t sum = 0;
+        for (size_t j = 0; j < I; j++) sum += kSizes[j];
+        return sum;
+    }();
+
+public:
+    template <size_t I>
+    using Field = std::tuple_element_t<I, std::tuple<Fields...>>;
+
+    constexpr SoAVec() noexcept = default;
+    explicit SoAVec(MemResource* mr) noexcept : SoABase(mr) {}
+    ~SoAVec() noexcept {
+        clear();
+        if (capacity() != 0) FreeColumnsOutline(Base<void>(), size_t{capacity()} * kRowBytes);
+    }
+    SoAVec(SoAVec&& other) noexcept = default;
+    SoAVec& operator=(SoAVec&& other) noexcept = default;
+
+    template <size_t I>
+    std::span<Field<I>> column() noexcept { return {Column<I>(), size()}; }
+    template <size_t I>
+    std::span<Field<I> const> column() const noexcept { return {Column<I>(), size()}; }
+
+    std::tuple<Fields&...> operator[](uint32_t idx) noexcept { return Row(idx, std::index_sequence_for<Fields...>{}); }
+    std::tuple<Fields const&...> operator[](uint32_t idx) const noexcept {
+        return Row(idx, std::index_sequence_for<Fields...>{});
+    }
+
+    void push_back(const std::tuple<Fields...>& row) noexcept { PushRow(row); }
+    void push_back(std::tuple<Fields...>&& row) noexcept { PushRow(std::move(row)); }
+    void push_back(const Fields&... xs) noexcept { PushRow(std::forward_as_tuple(xs...)); }
+
+    void pop_back() noexcept {
+        auto s = size() - 1;
+        Destroy(s, s + 1, std::index_sequence_for<Fields...>{});
+        SetSize(s);
+    }
+
+    void clear() noexcept {
+        Destroy(0, size(), std::index_sequence_for<Fields...>{});
+        SetSize(0);
+    }
+
+    // New rows are value initialized.
+    void resize(uint32_t n) noexcept {
+        auto s = size();
+        if (n < s) {
+            Destroy(n, s, std::index_sequence_for<Fields...>{});
+        } else if (n > s) {
+            reserve(n);
+            ValueInit(s, n, std::index_sequence_for<Fields...>{});
+        }
+        SetSize(n);
+    }
+
+    void reserve(uint32_t newcap) noexcept {
+        if (newcap > capacity()) Grow(newcap);
+    }
+
+private:
+    template <size_t I>
+    Field<I>* Column() const noexcept {
+        return reinterpret_cast<Field<I>*>(Base<std::byte>() + size_t{capacity()} * kPrefix<I>);
+    }
+
+    template <size_t... I>
+    auto Row(uint32_t idx, std::index_sequence<I...>) const noexcept {
+        return std::tuple<Fields&...>(Column<I>()[idx]...);
+    }
+
+    template <typename Tuple>
+    void PushRow(Tuple&& row) noexcept {
+        auto s = size();
+        if (s == capacity()) [[unlikely]] {
+            // row may refer into the buffer, so take it out before growing.
+            std::tuple<Fields...> tmp(std::forward<Tuple>(row));
+            Grow(s + 1);
+            Construct(s, std::move(tmp), std::index_sequence_for<Fields...>{});
+        } else {
+            Construct(s, std::forward<Tuple>(row), std::index_sequence_for<Fields...>{});
+        }
+        SetSize(s + 1);
+    }
+
+    // Each get takes a different field, so forwarding row once per field is fine.
+    template <typename Tuple, size_t... I>
+    void Construct(uint32_t idx, Tuple&& row, std::index_sequence<I...>) noexcept {
+        (new (Column<I>() + idx) Field<I>(std::get<I>(std::forward<Tuple>(row))), ...);
+    }
+
+    template <size_t... I>
+    void Destroy(uint32_t from, uint32_t to, std::index_sequence<I...>) noexcept {
+        (std::destroy(Column<I>() + from, Column<I>() + to), ...);
+    }
+
+    template <size_t... I>
+    void ValueInit(uint32_t from, uint32_t to, std::index_sequence<I...>) noexcept {
+        (std::uninitialized_value_construct(Column<I>() + from, Column<I>() + to), ...);
+    }
+
+    void Grow(uint32_t newcap) noexcept {
+        auto s = size();
+        auto [base, cap] = GrowColumnsOutline(Base<void>(), s, capacity(), kSizes, kCols, newcap);
+        SetBuffer(base, s, cap);
+    }
+};
+
+template <typename... Fields>
+inline constexpr bool is_known_relocatable_v<SoAVec<Fields...>> = true;
+
+}  // namespace gerben
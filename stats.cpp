@@ -0,0 +1,86 @@
+#include "stats.hpp"
+
+#include <algorithm>
+#include <bit>
+
+namespace gerben {
+
+VecStats StatsResource::snapshot() const noexcept {
+    VecStats s = {};
+    auto load = [](const std::atomic<uint64_t>& x) { return x.load(std::memory_order_relaxed); };
+    s.allocations = load(allocations_);
+    s.deallocations = load(deallocations_);
+    s.reallocations = load(reallocations_);
+    s.bytes_live = load(bytes_live_);
+    s.peak_bytes_live = load(peak_bytes_live_);
+    s.grows = load(grows_);
+    s.relocated_bytes = load(relocated_bytes_);
+    for (uint32_t i = 0; i < VecStats::kGrowBuckets; i++) s.grows_per_vector[i] = load(grows_per_vector_[i]);
+    for (uint32_t i = 0; i < VecStats::kFillBuckets; i++) s.fill_at_free[i] = load(fill_at_free_[i]);
+    std::lock_guard lock(mu_);
+    std::copy_n(call_sites_, num_call_sites_, s.call_sites);
+    std::sort(s.call_sites, s.call_sites + num_call_sites_,
+              [](const VecStats::CallSite& a, const VecStats::CallSite& b) { return a.samples > b.samples; });
+    s.num_call_sites = num_call_sites_;
+    return s;
+}
+
+void StatsResource::RecordGrow(const void* pc) noexcept {
+    auto n = grows_.fetch_add(1, std::memory_order_relaxed) + 1;
+    if (sample_every_ == 0 || n % sample_every_ != 0) return;
+    std::lock_guard lock(mu_);
+    for (uint32_t i = 0; i < num_call_sites_; i++) {
+        if (call_sites_[i].pc == pc) {
+            call_sites_[i].samples++;
+            return;
+        }
+    }
+    // Once the table is full new call sites go uncounted.
+    if (num_call_sites_ < VecStats::kMaxCallSites) call_sites_[num_call_sites_++] = {pc, 1};
+}
+
+void StatsResource::RecordFree(uint64_t grows, size_t cap_bytes, size_t live_bytes) noexcept {
+    Add(grows_per_vector_[std::min<uint64_t>(grows, VecStats::kGrowBuckets - 1)], 1);
+    uint32_t bucket = 0;
+    if (live_bytes != 0) {
+        bucket = std::min<uint32_t>(std::bit_width(cap_bytes / live_bytes), VecStats::kFillBuckets - 1);
+    }
+    Add(fill_at_free_[bucket], 1);
+}
+
+void* StatsResource::do_allocate(size_t bytes, size_t alignment) {
+    auto p = upstream_->allocate(bytes, alignment);
+    Add(allocations_, 1);
+    Resized(0, bytes);
+    return p;
+}
+
+void StatsResource::do_deallocate(void* p, size_t bytes, size_t alignment) {
+    upstream_->deallocate(p, bytes, alignment);
+    Add(deallocations_, 1);
+    Resized(bytes, 0);
+}
+
+bool StatsResource::do_try_expand(void* p, size_t old_bytes, size_t new_bytes, size_t alignment) {
+    if (!upstream_->try_expand(p, old_bytes, new_bytes, alignment)) return false;
+    Add(reallocations_, 1);
+    Resized(old_bytes, new_bytes);
+    return true;
+}
+
+void* StatsResource::do_reallocate(void* p, size_t old_bytes, size_t new_bytes, size_t alignment) {
+    auto res = upstream_->reallocate(p, old_bytes, new_bytes, alignment);
+    if (res == nullptr) return nullptr;
+    Add(reallocations_, 1);
+    Resized(old_bytes, new_bytes);
+    return res;
+}
+
+void StatsResource::Resized(size_t old_bytes, size_t new_bytes) noexcept {
+    auto live = bytes_live_.fetch_add(new_bytes - old_bytes, std::memory_order_relaxed) + new_bytes - old_bytes;
+    auto peak = peak_bytes_live_.load(std::memory_order_relaxed);
+    while (live > peak && !peak_bytes_live_.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {
+    }
+}
+
+}  // namespace gerben
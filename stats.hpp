@@ -0,0 +1,99 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+
+#include "vector.hpp"
+
+namespace gerben {
+
+// What a StatsResource saw, copied out by StatsResource::snapshot().
+struct VecStats {
+    static constexpr uint32_t kGrowBuckets = 16;
+    static constexpr uint32_t kFillBuckets = 8;
+    static constexpr uint32_t kMaxCallSites = 16;
+
+    struct CallSite {
+        // Return address of the sampled GrowOutline call, somewhere in the function that grew
+        // the vector. Symbolize with addr2line.
+        const void* pc;
+        uint64_t samples;
+    };
+
+    // Calls into the resource, whoever made them.
+    uint64_t allocations;
+    uint64_t deallocations;
+    uint64_t reallocations;
+    uint64_t bytes_live;
+    uint64_t peak_bytes_live;
+
+    // Only collected with GERBEN_VEC_STATS defined, from the outlined Vec paths.
+    uint64_t grows;
+    // Element bytes copied by growing or shrinking when the buffer couldn't be resized in place.
+    uint64_t relocated_bytes;
+    // Buffers freed after i grows, the last bucket also counts everything beyond.
+    uint64_t grows_per_vector[kGrowBuckets];
+    // Capacity over size of freed buffers. Bucket 0 counts the ones freed empty (or by a
+    // container that doesn't report its size), bucket i > 0 those with capacity below
+    // 2^i times the size, the last bucket everything beyond.
+    uint64_t fill_at_free[kFillBuckets];
+    // Every sample_every-th grow, by call site, most frequent first.
+    CallSite call_sites[kMaxCallSites];
+    uint32_t num_call_sites;
+};
+
+// Wraps another resource and counts what goes through it. The counts of the calls into the
+// resource are always kept. Compiling everything with GERBEN_VEC_STATS (bazel --define
+// vec_stats=1) adds hooks to the outlined grow and free paths of Vec, which report to the
+// StatsResource the buffer came from; without it those cost nothing and stay zero. The inline
+// push_back path doesn't change either way. Thread safe.
+class StatsResource : public MemResource {
+public:
+    // sample_every == 0 disables call site capture.
+    explicit StatsResource(MemResource* upstream = DefaultResource(), uint32_t sample_every = 0) noexcept
+        : upstream_(upstream), sample_every_(sample_every) {}
+    StatsResource(const StatsResource&) = delete;
+    StatsResource& operator=(const StatsResource&) = delete;
+
+    VecStats snapshot() const noexcept;
+
+    // Hooks for the outlined paths in vector.cpp.
+    void RecordGrow(const void* pc) noexcept;
+    void RecordRelocation(size_t bytes) noexcept { Add(relocated_bytes_, bytes); }
+    void RecordFree(uint64_t grows, size_t cap_bytes, size_t live_bytes) noexcept;
+
+private:
+    void* do_allocate(size_t bytes, size_t alignment) override;
+    void do_deallocate(void* p, size_t bytes, size_t alignment) override;
+    bool do_try_expand(void* p, size_t old_bytes, size_t new_bytes, size_t alignment) override;
+    void* do_reallocate(void* p, size_t old_bytes, size_t new_bytes, size_t alignment) override;
+    bool do_is_equal(std::pmr::memory_resource const& other) const noexcept override {
+        return this == &other;
+    }
+
+    static void Add(std::atomic<uint64_t>& counter, uint64_t n) noexcept {
+        counter.fetch_add(n, std::memory_order_relaxed);
+    }
+    void Resized(size_t old_bytes, size_t new_bytes) noexcept;
+
+    MemResource* const upstream_;
+    const uint32_t sample_every_;
+
+    std::atomic<uint64_t> allocations_{0};
+    std::atomic<uint64_t> deallocations_{0};
+    std::atomic<uint64_t> reallocations_{0};
+    std::atomic<uint64_t> bytes_live_{0};
+    std::atomic<uint64_t> peak_bytes_live_{0};
+    std::atomic<uint64_t> grows_{0};
+    std::atomic<uint64_t> relocated_bytes_{0};
+    std::atomic<uint64_t> grows_per_vector_[VecStats::kGrowBuckets] = {};
+    std::atomic<uint64_t> fill_at_free_[VecStats::kFillBuckets] = {};
+
+    // Only touched for sampled grows.
+    mutable std::mutex mu_;
+    VecStats::CallSite call_sites_[VecStats::kMaxCallSites] = {};
+    uint32_t num_call_sites_ = 0;
+};
+
+}  // namespace gerben
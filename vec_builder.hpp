@@ -0,0 +1,149 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <ranges>
+#include <span>
+#include <utility>
+
+#include "vector.hpp"
+
+namespace gerben {
+
+// Takes over a Vec and keeps its base, size and capacity in locals of the caller, so stores into
+// the elements can't alias them and the loop keeps size in a register, which LocalCapture gets
+// only when everything is inlined. Growth goes through the static GrowOutline, which takes the
+// three by value, so the builder's address never escapes. The destructor hands the buffer back,
+// so early returns are fine. The Vec is empty and must not be used while the builder lives.
+//
+//   VecBuilder b(&out);
+//   for (auto& x : in) {
+//       if (!x.ok()) return;
+//       b.emplace_back(x.value());
+//   }
+template <IsNoThrowMoveConstructible T, GrowthPolicy G = GrowthPolicy{}>
+class VecBuilder {
+public:
+    explicit VecBuilder(Vec<T, G>* vec) noexcept
+        : vec_(vec), base_or_mr_(vec->base_or_mr_), size_(vec->size_), cap_(vec->cap_) {
+        vec->base_or_mr_ = vec->Resource();
+        vec->size_ = 0;
+        vec->cap_ = 0;
+    }
+    ~VecBuilder() noexcept { vec_->SetBuffer(base_or_mr_, size_, cap_); }
+    VecBuilder(const VecBuilder&) = delete;
+    VecBuilder& operator=(const VecBuilder&) = delete;
+
+    uint32_t size() const noexcept { return size_; }
+    bool empty() const noexcept { return size_ == 0; }
+    uint32_t capacity() const noexcept { return cap_; }
+
+    T* data() noexcept { return Base(); }
+    T* begin() noexcept { return Base(); }
+    T* end() noexcept { return Base() + size_; }
+    T& operator[](uint32_t idx) noexcept { return Base()[idx]; }
+    T& back() noexcept { return Base()[size_ - 1]; }
+
+    void reserve(uint32_t newcap) noexcept {
+        if (newcap > cap_) Grow(newcap);
+    }
+
+    void push_back(const T& x) noexcept { emplace_back(x); }
+    void push_back(T&& x) noexcept { emplace_back(std::move(x)); }
+
+    template <typename... Args>
+    T& emplace_back(Args&&... args) noexcept {
+        auto s = size_;
+        if (s == cap_) [[unlikely]] {
+            // args may refer into the buffer, so construct before growing it.
+            T tmp(std::forward<Args>(args)...);
+            Grow(s + 1);
+            return Place(s, std::move(tmp));
+        }
+        return Place(s, std::forward<Args>(args)...);
+    }
+
+    T pop_back() noexcept {
+        auto p = Base() + --size_;
+        T res = std::move(*p);
+        p->~T();
+        return res;
+    }
+
+    T* insert(T* position, T x) noexcept {
+        auto idx = static_cast<uint32_t>(position - Base());
+        reserve(size_ + 1);
+        auto p = Base();
+        if constexpr (is_relocatable_v<T>) {
+            std::memmove(static_cast<void*>(p + idx + 1), p + idx, size_t{size_ - idx} * sizeof(T));
+        } else {
+            for (uint32_t i = size_; i-- > idx;) {
+                new (p + i + 1) T(std::move(p[i]));
+                p[i].~T();
+            }
+        }
+        new (p + idx) T(std::move(x));
+        size_++;
+        return p + idx;
+    }
+
+    // Like the Vec members, the range must not alias the vector.
+    void append(std::span<const T> xs) noexcept { append_range(xs); }
+
+    template <std::ranges::input_range R>
+    void append_range(R&& r) noexcept {
+        if constexpr (std::ranges::forward_range<R> || std::ranges::sized_range<R>) {
+            auto n = static_cast<uint32_t>(std::ranges::distance(r));
+            if (n > UINT32_MAX - size_) [[unlikely]] std::abort();
+            reserve(size_ + n);
+            VecBase::ConstructN(Base() + size_, std::ranges::begin(r), n);
+            size_ += n;
+        } else {
+            for (auto&& x : r) emplace_back(std::forward<decltype(x)>(x));
+        }
+    }
+
+    // As Vec::append_with.
+    template <typename F>
+    uint32_t append_with(uint32_t n, F&& fill) noexcept {
+        if (n > UINT32_MAX - size_) [[unlikely]] std::abort();
+        reserve(size_ + n);
+        uint32_t k = n;
+        if constexpr (std::is_void_v<std::invoke_result_t<F&, T*>>) {
+            fill(Base() + size_);
+        } else {
+            k = static_cast<uint32_t>(fill(Base() + size_));
+        }
+        size_ += k;
+        return k;
+    }
+
+    void clear() noexcept {
+        std::destroy_n(Base(), size_);
+        size_ = 0;
+    }
+
+private:
+    T* Base() const noexcept { return static_cast<T*>(base_or_mr_); }
+
+    template <typename... Args>
+    T& Place(uint32_t s, Args&&... args) noexcept {
+        auto p = new (Base() + s) T(std::forward<Args>(args)...);
+        size_ = s + 1;
+        return *p;
+    }
+
+    void Grow(uint32_t newcap) noexcept {
+        VecBase::Relocator mover = nullptr;
+        if constexpr (!is_relocatable_v<T>) mover = &VecBase::Relocate<T>;
+        std::tie(base_or_mr_, cap_) = VecBase::GrowOutline(base_or_mr_, size_, cap_, sizeof(T), mover, newcap, G);
+    }
+
+    Vec<T, G>* const vec_;
+    void* base_or_mr_;
+    uint32_t size_;
+    uint32_t cap_;
+};
+
+}  // namespace gerben
@@ -1,7 +1,12 @@
 #include "vector.hpp"
 
+#include <bit>
 #include <cstdint>
 
+#ifdef GERBEN_VEC_STATS
+#include "stats.hpp"
+#endif
+
 namespace gerben {
 
 [[noreturn]] void ThrowOutOfRange() {
@@ -19,13 +24,20 @@ class DefaultAlloc : public MemResource {
     void do_deallocate(void* p, size_t, size_t) override {
         std::free(p);
     }
-    bool do_is_equal(MemResource const& other) const noexcept override {
+    void* do_reallocate(void* p, size_t, size_t new_bytes, size_t) override {
+        return std::realloc(p, new_bytes);
+    }
+    bool do_is_equal(std::pmr::memory_resource const& other) const noexcept override {
         return this == &other;
     }
 };
 
 constinit DefaultAlloc def_alloc;
 
+MemResource* DefaultResource() noexcept {
+    return &def_alloc;
+}
+
 
 inline MemResource*& MemoryResource(void* ptr) {
     return static_cast<MemResource**>(ptr)[-1];
@@ -36,6 +48,9 @@ inline void* Alloc(MemResource* mr, size_t cap, size_t elem_size) noexcept {
         auto ptr = mr->allocate(cap *  elem_size + sizeof(std::max_align_t), sizeof(std::max_align_t));
         ptr = static_cast<std::byte*>(ptr) + sizeof(std::max_align_t);
         MemoryResource(ptr) = mr;
+#ifdef GERBEN_VEC_STATS
+        StatsHeader(ptr) = {};
+#endif
         return ptr;
     } ___catch(...) {
         abort();
@@ -46,29 +61,148 @@ inline void Dealloc(MemResource* mr, void* base, size_t bytes) noexcept {
     mr->deallocate(static_cast<std::max_align_t*>(base) - 1, bytes + sizeof(std::max_align_t), sizeof(std::max_align_t));
 }
 
-std::pair<void*, uint32_t> VecBase::GrowOutline(void* base, uint32_t size, uint32_t cap, uint32_t elem_size, Relocator relocate, uint32_t newcap) noexcept {
+inline bool TryExpand(MemResource* mr, void* base, size_t old_bytes, size_t new_bytes) noexcept {
+    ___try {
+        return mr->try_expand(static_cast<std::max_align_t*>(base) - 1, old_bytes + sizeof(std::max_align_t), new_bytes + sizeof(std::max_align_t), sizeof(std::max_align_t));
+    } ___catch(...) {
+        abort();
+    }
+}
+
+// Returns nullptr if the resource can't reallocate, the old buffer is untouched in that case.
+inline void* Realloc(MemResource* mr, void* base, size_t old_bytes, size_t new_bytes) noexcept {
+    ___try {
+        auto ptr = mr->reallocate(static_cast<std::max_align_t*>(base) - 1, old_bytes + sizeof(std::max_align_t), new_bytes + sizeof(std::max_align_t), sizeof(std::max_align_t));
+        if (ptr == nullptr) return nullptr;
+        return static_cast<std::max_align_t*>(ptr) + 1;
+    } ___catch(...) {
+        abort();
+    }
+}
+
+#ifdef GERBEN_VEC_STATS
+
+// The hooks only report to buffers allocated from a StatsResource, they're never called for
+// inline buffers.
+inline StatsResource* StatsOf(MemResource* mr) noexcept { return dynamic_cast<StatsResource*>(mr); }
+
+inline void OnGrow(void* base, const void* pc) noexcept {
+    StatsHeader(base).grows++;
+    if (auto stats = StatsOf(MemoryResource(base))) stats->RecordGrow(pc);
+}
+
+inline void OnRelocate(void* newbase, void* base, bool was_inline, size_t bytes) noexcept {
+    if (!was_inline) StatsHeader(newbase) = StatsHeader(base);
+    if (auto stats = StatsOf(MemoryResource(newbase))) stats->RecordRelocation(bytes);
+}
+
+inline void OnFree(MemResource* mr, void* base, size_t bytes) noexcept {
+    if (auto stats = StatsOf(mr)) stats->RecordFree(StatsHeader(base).grows, bytes, StatsHeader(base).live_bytes);
+}
+
+#else
+
+inline void OnGrow(void*, const void*) noexcept {}
+inline void OnRelocate(void*, void*, bool, size_t) noexcept {}
+inline void OnFree(MemResource*, void*, size_t) noexcept {}
+
+#endif
+
+inline size_t RoundUp(size_t x, size_t multiple) {
+    return (x + multiple - 1) / multiple * multiple;
+}
+
+// Rounds up an allocation, header included, to where the allocator would put it anyway.
+size_t RoundAllocation(size_t bytes, GrowthPolicy::Rounding rounding) {
+    constexpr size_t kPageSize = 4096;
+    constexpr size_t kHugePageSize = 2 << 20;
+    if (rounding == GrowthPolicy::kNone) return bytes;
+    if (rounding == GrowthPolicy::kHugePage && bytes >= kHugePageSize) return RoundUp(bytes, kHugePageSize);
+    if (rounding >= GrowthPolicy::kPage && bytes >= kPageSize) return RoundUp(bytes, kPageSize);
+    if (bytes <= 128) return RoundUp(bytes, 16);
+    return RoundUp(bytes, std::bit_floor(bytes - 1) / 4);
+}
+
+uint32_t NewCapacity(uint32_t cap, uint32_t elem_size, uint32_t newcap, GrowthPolicy policy) {
+    uint64_t n;
+    if (cap == 0) {
+        n = std::max<uint64_t>(1, (uint64_t{policy.min_bytes} + elem_size - 1) / elem_size);
+    } else {
+        n = std::max<uint64_t>(cap + 1, uint64_t{cap} * policy.numerator / policy.denominator);
+    }
+    n = std::max<uint64_t>(n, newcap);
+    n = (RoundAllocation(n * elem_size + sizeof(std::max_align_t), policy.rounding) - sizeof(std::max_align_t)) / elem_size;
+    return std::min<uint64_t>(n, UINT32_MAX);
+}
+
+std::pair<void*, uint32_t> VecBase::GrowOutline(void* base, uint32_t size, uint32_t cap, uint32_t elem_size, Relocator relocate, uint32_t newcap, GrowthPolicy policy) noexcept {
+    newcap = NewCapacity(cap, elem_size, newcap, policy);
+    std::pair<void*, uint32_t> res;
     if (cap == 0) {
         auto mr = static_cast<MemResource*>(base);
         if (mr == nullptr) mr = &def_alloc;
-        newcap = std::max<uint32_t>(newcap, 1);
-        auto newbase = Alloc(mr, newcap, elem_size);
-        return {newbase, newcap};
+        res = {Alloc(mr, newcap, elem_size), newcap};
     } else {
-        auto mr = MemoryResource(base);
-        newcap = std::max<uint32_t>(newcap, cap * 2);
-        auto newbase = Alloc(mr, newcap, elem_size);
-        if (relocate) {
-            relocate(newbase, base, size);
-        } else {
-            std::memcpy(newbase, base, size * elem_size);
+        res = ReallocOutline(base, size, cap, elem_size, relocate, newcap);
+    }
+    OnGrow(res.first, __builtin_return_address(0));
+    return res;
+}
+
+std::pair<void*, uint32_t> VecBase::ReallocOutline(void* base, uint32_t size, uint32_t cap, uint32_t elem_size, Relocator relocate, uint32_t newcap) noexcept {
+    auto is_inline = Header(base) & kInlineTag;
+    auto mr = reinterpret_cast<MemResource*>(Header(base) & ~kInlineTag);
+    if (mr == nullptr) mr = &def_alloc;
+    if (newcap == 0) {
+        if (!is_inline) {
+            OnFree(mr, base, size_t{cap} * elem_size);
+            Dealloc(mr, base, size_t{cap} * elem_size);
+        }
+        return {mr, 0};
+    }
+    if (!is_inline && newcap > cap && TryExpand(mr, base, size_t{cap} * elem_size, size_t{newcap} * elem_size)) {
+        return {base, newcap};
+    }
+    if (relocate == nullptr && !is_inline) {
+        // Bitwise relocatable, so the resource is free to move the buffer (e.g. mremap).
+        if (auto newbase = Realloc(mr, base, size_t{cap} * elem_size, size_t{newcap} * elem_size)) {
+            return {newbase, newcap};
         }
-        Dealloc(mr, base, cap * elem_size);
-        return {newbase, newcap};
     }
+    auto newbase = Alloc(mr, newcap, elem_size);
+    if (relocate) {
+        relocate(newbase, base, size);
+    } else {
+        std::memcpy(newbase, base, size_t{size} * elem_size);
+    }
+    OnRelocate(newbase, base, is_inline, size_t{size} * elem_size);
+    if (!is_inline) Dealloc(mr, base, size_t{cap} * elem_size);
+    return {newbase, newcap};
+}
+
+std::pair<void*, uint32_t> VecBase::CopyOutline(const void* base, uint32_t size, uint32_t elem_size, Copier copy, MemResource* mr) noexcept {
+    if (mr == nullptr) mr = &def_alloc;
+    auto newbase = Alloc(mr, size, elem_size);
+    if (copy) {
+        copy(newbase, base, size);
+    } else {
+        std::memcpy(newbase, base, size_t{size} * elem_size);
+    }
+    return {newbase, size};
+}
+
+void* AllocateVecBuffer(size_t bytes, MemResource* mr) noexcept {
+    return Alloc(mr ? mr : &def_alloc, bytes, 1);
+}
+
+void DeallocateVecBuffer(void* data, size_t bytes) noexcept {
+    Dealloc(MemoryResource(data), data, bytes);
 }
 
 void VecBase::FreeOutline(void* base, size_t bytes) noexcept {
+    if (Header(base) & kInlineTag) return;
     auto mr = MemoryResource(base);
+    OnFree(mr, base, bytes);
     Dealloc(mr, base, bytes);
 }
 
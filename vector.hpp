@@ -1,13 +1,19 @@
+#pragma once
+
 #include <algorithm>
 #include <type_traits>
 #include <cstdint>
+#include <cstdlib>
 #include <cstring>
 #include <tuple>
+#include <utility>
+#include <concepts>
 #include <new>
 #include <vector>
 #include <memory>
 #include <memory_resource>
 #include <ranges>
+#include <span>
 #include <string>
 
 #ifdef __cpp_exceptions
@@ -20,6 +26,16 @@
 #define ___rethrow 0
 #endif
 
+// Vec members marked ___constexpr work in constant evaluation, where buffers come from
+// std::allocator<T> instead of the outlined paths. That needs casting the stored void* back to
+// T*, which C++26 allows and GCC accepts already. Elsewhere they are plain runtime functions.
+#if __cpp_constexpr >= 202306L || (defined(__GNUC__) && !defined(__clang__))
+#define GERBEN_CONSTEXPR_VEC 1
+#define ___constexpr constexpr
+#else
+#define ___constexpr
+#endif
+
 namespace gerben {
 
 template <typename T>
@@ -29,17 +45,69 @@ template <typename T>
 inline constexpr bool is_known_relocatable_v<std::unique_ptr<T>> = true;
 template <typename T>
 inline constexpr bool is_known_relocatable_v<std::vector<T>> = true;
+#ifdef _LIBCPP_VERSION
+// libstdc++'s std::string points into itself when using SSO.
 template <>
 inline constexpr bool is_known_relocatable_v<std::string> = true;
+#endif
+
+#if defined(__has_builtin)
+#if __has_builtin(__is_trivially_relocatable)
+#define GERBEN_HAS_TRIVIALLY_RELOCATABLE_BUILTIN 1
+#endif
+#endif
+
+// Relocatable types are moved around with memcpy/memmove/realloc instead of move-construct +
+// destroy. Trivially copyable types (and [[clang::trivial_abi]] ones on clang) are relocatable
+// as is, other types opt in with GERBEN_RELOCATABLE or by specializing is_known_relocatable_v.
+template <typename T>
+inline constexpr bool is_relocatable_v = std::is_trivially_copyable_v<T> ||
+#ifdef GERBEN_HAS_TRIVIALLY_RELOCATABLE_BUILTIN
+    __is_trivially_relocatable(T) ||
+#endif
+    is_known_relocatable_v<T>;
+
+// Set for classes deriving from Vec whose buffer can't change owner, like MappedVec, so moving
+// one into a plain Vec doesn't compile instead of slicing. Copies are fine.
+template <typename T>
+inline constexpr bool is_pinned_vec_v = false;
 
+// Set for classes deriving from Vec whose buffer may live inside the object, like SmallVec. Plain
+// Vec moves and swaps exchange the three words and only check for an inline buffer when the
+// other side's static type may have one, so such an object must not be moved or swapped through
+// a Vec&.
 template <typename T>
-inline constexpr bool is_relocatable_v = std::is_trivial_v<T> || is_known_relocatable_v<T>;
+inline constexpr bool has_inline_buffer_v = false;
+
+// Declares a type relocatable, use at global namespace scope: GERBEN_RELOCATABLE(my::Type);
+#define GERBEN_RELOCATABLE(...) \
+    namespace gerben { template <> inline constexpr bool is_known_relocatable_v<__VA_ARGS__> = true; } \
+    static_assert(true)
 
 [[noreturn]] void ThrowOutOfRange();
 
 #if 1
 
-using MemResource = std::pmr::memory_resource;
+class MemResource : public std::pmr::memory_resource {
+public:
+    // Resizes the allocation at ptr without moving it. Returns false if that's not possible.
+    bool try_expand(void* ptr, size_t old_bytes, size_t new_bytes, size_t alignment) {
+        return do_try_expand(ptr, old_bytes, new_bytes, alignment);
+    }
+    // Resizes the allocation at ptr preserving its contents bitwise, possibly moving it. Returns
+    // nullptr if the resource can't, in which case the caller falls back to allocate/copy/deallocate.
+    void* reallocate(void* ptr, size_t old_bytes, size_t new_bytes, size_t alignment) {
+        return do_reallocate(ptr, old_bytes, new_bytes, alignment);
+    }
+    // The resource copies of a vector on this one allocate from. A resource owning just the one
+    // buffer, like a mapped file, sends them elsewhere so the copy doesn't depend on its lifetime.
+    MemResource* copy_resource() noexcept { return do_copy_resource(); }
+
+private:
+    virtual bool do_try_expand(void*, size_t, size_t, size_t) { return false; }
+    virtual void* do_reallocate(void*, size_t, size_t, size_t) { return nullptr; }
+    virtual MemResource* do_copy_resource() noexcept { return this; }
+};
 
 #else
 
@@ -51,15 +119,89 @@ public:
     void deallocate(void* ptr, size_t bytes, size_t alignment) {
         return do_deallocate(ptr, bytes, alignment);
     }
+    bool try_expand(void* ptr, size_t old_bytes, size_t new_bytes, size_t alignment) {
+        return do_try_expand(ptr, old_bytes, new_bytes, alignment);
+    }
+    void* reallocate(void* ptr, size_t old_bytes, size_t new_bytes, size_t alignment) {
+        return do_reallocate(ptr, old_bytes, new_bytes, alignment);
+    }
+    // The resource copies of a vector on this one allocate from. A resource owning just the one
+    // buffer, like a mapped file, sends them elsewhere so the copy doesn't depend on its lifetime.
+    MemResource* copy_resource() noexcept { return do_copy_resource(); }
 
 private:
     virtual void* do_allocate(size_t bytes, size_t alignment) = 0;
     virtual void do_deallocate(void* ptr, size_t bytes, size_t alignment) = 0;
+    virtual bool do_try_expand(void*, size_t, size_t, size_t) { return false; }
+    virtual void* do_reallocate(void*, size_t, size_t, size_t) { return nullptr; }
+    virtual MemResource* do_copy_resource() noexcept { return this; }
     virtual bool do_is_equal(MemResource const& other) const noexcept = 0;
 };
 
 #endif
 
+// The malloc backed resource used by vectors that weren't given one.
+MemResource* DefaultResource() noexcept;
+
+// Layout of a Vec buffer. The vector points at the first element, which is preceded by a header
+// of kVecHeaderSize bytes, and the whole block
+//
+//   [ header: kVecHeaderSize bytes | capacity * sizeof(T) bytes of elements ]
+//
+// is one allocation of kVecHeaderSize + capacity * sizeof(T) bytes, aligned to kVecHeaderSize,
+// from the MemResource whose address is stored in the last word of the header. The other header
+// words belong to the Vec. A producer outside Vec can fill such a buffer and hand it over with
+// Vec::adopt without a copy. It either gets it from AllocateVecBuffer, or allocates the block from
+// a resource itself and passes that resource to adopt.
+inline constexpr size_t kVecHeaderSize = sizeof(std::max_align_t);
+
+// Allocates room for bytes of elements with the header in front and returns the start of the
+// elements. nullptr allocates from the default resource. Aborts on failure like Vec.
+void* AllocateVecBuffer(size_t bytes, MemResource* mr = nullptr) noexcept;
+// Frees a buffer from AllocateVecBuffer or Vec::release, bytes being capacity * sizeof(T). Any
+// elements still in it must have been destroyed.
+void DeallocateVecBuffer(void* data, size_t bytes) noexcept;
+
+// How a Vec picks its capacity when it grows. It's a compile time parameter of Vec, but is
+// passed to the outlined grow path as a register sized value so all policies share that code.
+struct GrowthPolicy {
+    enum Rounding : uint8_t {
+        kNone,
+        // Round the allocation up to a typical malloc size class, 16 byte granular for small
+        // sizes and four classes per power of two beyond.
+        kMalloc,
+        // As kMalloc, but allocations of at least a page are rounded to whole 4 KiB pages.
+        kPage,
+        // As kPage, but allocations of at least 2 MiB are rounded to whole huge pages.
+        kHugePage,
+    };
+
+    // Lower bound on the first allocation.
+    uint32_t min_bytes = 0;
+    // Capacity grows by a factor numerator / denominator, but always by at least one.
+    uint8_t numerator = 2;
+    uint8_t denominator = 1;
+    Rounding rounding = kNone;
+};
+
+template <typename T>
+concept IsNoThrowMoveConstructible = std::is_nothrow_move_constructible_v<T>;
+
+#ifdef GERBEN_VEC_STATS
+// With GERBEN_VEC_STATS the buffer header also carries what StatsResource reports per vector,
+// below the words CompactVec keeps there. Inline buffers don't have it.
+struct VecStatsHeader {
+    uint64_t grows;
+    // Written by ~Vec just before the buffer is freed.
+    uint64_t live_bytes;
+};
+// Bytes [-32, -16) of the header, clear of CompactVec's word and the MemResource*, which
+// relies on max_align_t being 32 bytes as it is with GCC on x86-64.
+static_assert(sizeof(VecStatsHeader) == 2 * sizeof(uint64_t) && kVecHeaderSize >= 2 * sizeof(VecStatsHeader),
+              "GERBEN_VEC_STATS needs a 32 byte buffer header");
+inline VecStatsHeader& StatsHeader(void* base) noexcept { return static_cast<VecStatsHeader*>(base)[-2]; }
+#endif
+
 class VecBase {
 public:
     constexpr uint32_t size() const noexcept { return size_; }
@@ -69,21 +211,37 @@ public:
 protected:
     constexpr VecBase() noexcept = default;
     constexpr VecBase(MemResource* mr) noexcept : base_or_mr_(mr) {};
-    VecBase(VecBase&& other) noexcept : VecBase() {
+    constexpr VecBase(VecBase&& other) noexcept : VecBase() {
         Swap(other);
     }
-    VecBase& operator=(VecBase&& other) noexcept {
+    constexpr VecBase& operator=(VecBase&& other) noexcept {
         Swap(other);
         return *this;       
     }
 
     template <typename T>
-    void Free() {
-        if (cap_ != 0) FreeOutline(base_or_mr_, cap_ * sizeof(T));
+    ___constexpr void Free() {
+        if (cap_ == 0) return;
+        if (std::is_constant_evaluated()) {
+            std::allocator<T>().deallocate(Base<T>(), cap_);
+        } else {
+            FreeOutline(base_or_mr_, cap_ * sizeof(T));
+        }
+    }
+#ifdef GERBEN_VEC_STATS
+    // The header starts at 0, and a derived class that clears before ~Vec notes it first.
+    template <typename T>
+    void NoteLiveBytes() noexcept {
+        if (size_ != 0 && !IsInline()) StatsHeader(base_or_mr_).live_bytes = size_t{size_} * sizeof(T);
     }
+#endif
 
+    // Constant evaluation only allows casting void* that points at a T, which rules out null.
     template<typename T>
-    T* Base() const { return static_cast<T*>(base_or_mr_); }
+    ___constexpr T* Base() const {
+        if (std::is_constant_evaluated() && base_or_mr_ == nullptr) return nullptr;
+        return static_cast<T*>(base_or_mr_);
+    }
 
     using Relocator = void (*)(void* dst, void *src, uint32_t size) noexcept;
 
@@ -92,37 +250,186 @@ protected:
         auto d = static_cast<T*>(dst);
         auto s = static_cast<T*>(src);
         for (uint32_t i = 0; i < size; i++) {
-            T tmp = std::move(s[i]);
+            new (d + i) T(std::move(s[i]));
             s[i].~T();
-            new (d + i) T(std::move(tmp));
         }
     }
 
-    void Swap(VecBase& other) noexcept {
+    using Copier = void (*)(void* dst, const void* src, uint32_t size) noexcept;
+
+    template <typename T>
+    static void Copy(void* dst, const void* src, uint32_t size) noexcept {
+        auto d = static_cast<T*>(dst);
+        auto s = static_cast<const T*>(src);
+        for (uint32_t i = 0; i < size; i++) new (d + i) T(s[i]);
+    }
+
+    // nullptr for trivially copyable T, which CopyOutline copies with memcpy.
+    template <typename T>
+    static constexpr Copier CopierFor() noexcept {
+        if constexpr (std::is_trivially_copyable_v<T>) {
+            return nullptr;
+        } else {
+            return &Copy<T>;
+        }
+    }
+
+    // Becomes a copy of the n elements at src in a buffer of exactly n from mr, assuming there's
+    // no buffer now.
+    template <typename T>
+    void CopyFrom(const T* src, uint32_t n, MemResource* mr) noexcept {
+        if (n == 0) {
+            SetBuffer(mr, 0, 0);
+        } else {
+            auto [base, cap] = CopyOutline(src, n, sizeof(T), CopierFor<T>(), mr);
+            SetBuffer(base, n, cap);
+        }
+    }
+
+    constexpr void Swap(VecBase& other) noexcept {
         std::swap(base_or_mr_, other.base_or_mr_);
         std::swap(size_, other.size_);
         std::swap(cap_, other.cap_);
     }
 
     template <typename T>
-    void AddAlreadyReserved(T x) noexcept {
+    static void RelocateN(T* dst, T* src, uint32_t size) noexcept {
+        if constexpr (is_relocatable_v<T>) {
+            std::memcpy(static_cast<void*>(dst), src, size_t{size} * sizeof(T));
+        } else {
+            Relocate<T>(dst, src, size);
+        }
+    }
+
+    // Buffers are preceded by a header whose last word holds the MemResource* that allocated them.
+    // SmallVec's inline buffer has the same header with kInlineTag set, so the outlined grow and
+    // free paths know not to hand it back to the resource.
+    static constexpr uintptr_t kInlineTag = 1;
+    static uintptr_t& Header(void* base) noexcept { return static_cast<uintptr_t*>(base)[-1]; }
+
+    bool IsInline() const noexcept { return cap_ != 0 && (Header(base_or_mr_) & kInlineTag); }
+    // nullptr means the default resource.
+    MemResource* Resource() const noexcept {
+        if (cap_ == 0) return static_cast<MemResource*>(base_or_mr_);
+        return reinterpret_cast<MemResource*>(Header(base_or_mr_) & ~kInlineTag);
+    }
+    MemResource* CopyResource() const noexcept {
+        auto mr = Resource();
+        return mr ? mr->copy_resource() : nullptr;
+    }
+    void SetInline(void* base, uint32_t cap, MemResource* mr) noexcept {
+        Header(base) = reinterpret_cast<uintptr_t>(mr) | kInlineTag;
+        base_or_mr_ = base;
+        size_ = 0;
+        cap_ = cap;
+    }
+    // Forgets an empty inline buffer so the storage can go away before ~Vec runs.
+    void DetachInline() noexcept {
+        if (IsInline()) {
+            base_or_mr_ = Resource();
+            cap_ = 0;
+        }
+    }
+
+    // Moving swaps buffers, unless an inline buffer is involved which can't change owner. Only
+    // used when one side may have one, see has_inline_buffer_v.
+    template <typename T>
+    void MoveAny(VecBase& other) noexcept {
+        if (IsInline() || other.IsInline()) [[unlikely]] {
+            MoveSlow<T>(other);
+        } else {
+            Swap(other);
+        }
+    }
+    template <typename T>
+    void MoveSlow(VecBase& other) noexcept {
+        if (this == &other) return;
+        std::destroy_n(Base<T>(), size_);
+        size_ = 0;
+        if (other.IsInline()) {
+            Reserve<T>(other.size_);
+            RelocateN(Base<T>(), other.Base<T>(), other.size_);
+            std::swap(size_, other.size_);
+        } else if (other.cap_ != 0) {
+            // Only our buffer is inline, abandon it and take over the heap buffer.
+            auto mr = other.Resource();
+            base_or_mr_ = other.base_or_mr_;
+            size_ = other.size_;
+            cap_ = other.cap_;
+            other.base_or_mr_ = mr;
+            other.size_ = 0;
+            other.cap_ = 0;
+        }
+    }
+
+    template <typename T>
+    ___constexpr void AddAlreadyReserved(T x) noexcept {
         auto s = size_;
-        new (Base<T>() + s) T(std::move(x));
+        std::construct_at(Base<T>() + s, std::move(x));
         size_ = s + 1;
     }
 
-    template <typename T>
-    void Add(T x) noexcept {
+    // Constructs n elements at dst from the range starting at first. Copying out of a source
+    // requires trivially copyable, relocatable only covers moving from a source that dies.
+    template <typename T, typename It>
+    static ___constexpr void ConstructN(T* dst, It first, uint32_t n) noexcept {
+        if constexpr (std::is_trivially_copyable_v<T> && std::contiguous_iterator<It> &&
+                      std::is_same_v<std::iter_value_t<It>, T>) {
+            if (!std::is_constant_evaluated()) {
+                if (n) std::memcpy(static_cast<void*>(dst), std::to_address(first), size_t{n} * sizeof(T));
+                return;
+            }
+        }
+        for (uint32_t i = 0; i < n; i++, ++first) std::construct_at(dst + i, *first);
+    }
+
+    // Makes room for n elements at idx by shifting the tail up. Returns the uninitialized gap,
+    // the caller constructs the elements and adjusts the size.
+    template <typename T, GrowthPolicy G = GrowthPolicy{}>
+    T* OpenGap(uint32_t idx, uint32_t n) noexcept {
+        Reserve<T, G>(size_ + n);
+        auto p = Base<T>();
+        if constexpr (is_relocatable_v<T>) {
+            std::memmove(static_cast<void*>(p + idx + n), p + idx, size_t{size_ - idx} * sizeof(T));
+        } else {
+            for (uint32_t i = size_; i-- > idx;) {
+                new (p + i + n) T(std::move(p[i]));
+                p[i].~T();
+            }
+        }
+        return p + idx;
+    }
+
+    template <typename T, GrowthPolicy G = GrowthPolicy{}>
+    ___constexpr void Add(T x) noexcept {
         auto s = size_;
         auto c = cap_;
         if (s >= c) {
-            Grow<T>();
+            Grow<T, G>();
         }
-        new (Base<T>() + s) T(std::move(x));
+        std::construct_at(Base<T>() + s, std::move(x));
         size_ = s + 1;
     }
+    // Constructs in place instead of moving in a temporary. Like Add, the members are only
+    // touched through locals and Grow, so this doesn't escape.
+    template <typename T, GrowthPolicy G = GrowthPolicy{}, typename... Args>
+    ___constexpr T& AddEmplace(Args&&... args) noexcept {
+        auto s = size_;
+        auto c = cap_;
+        T* p;
+        if (s >= c) {
+            // args may refer into the buffer, so construct before growing it.
+            T tmp(std::forward<Args>(args)...);
+            Grow<T, G>();
+            p = std::construct_at(Base<T>() + s, std::move(tmp));
+        } else {
+            p = std::construct_at(Base<T>() + s, std::forward<Args>(args)...);
+        }
+        size_ = s + 1;
+        return *p;
+    }
     template <typename T>
-    T Remove() noexcept {
+    ___constexpr T Remove() noexcept {
         auto p = Base<T>();
         auto s = size_ - 1;
         T res = std::move(p[s]);
@@ -130,26 +437,96 @@ protected:
         size_ = s;
         return res;
     }
-    template <typename T>
-    void Reserve(uint32_t newcap) noexcept {
+    template <typename T, GrowthPolicy G = GrowthPolicy{}>
+    ___constexpr void Reserve(uint32_t newcap) noexcept {
         if (newcap > cap_) {
-            Grow<T>(newcap);
+            Grow<T, G>(newcap);
         }
     }
     constexpr void SetSize(uint32_t s) noexcept { size_ = s; }
+    // Takes over a buffer carrying the hidden header, without freeing the current one.
+    void SetBuffer(void* base, uint32_t size, uint32_t cap) noexcept {
+        base_or_mr_ = base;
+        size_ = size;
+        cap_ = cap;
+    }
+
+    template <typename T, GrowthPolicy G = GrowthPolicy{}>
+    ___constexpr void Grow(uint32_t newcap = 0) noexcept {
+        if (std::is_constant_evaluated()) return GrowConstant<T, G>(newcap);
+        Relocator mover = nullptr;
+        if constexpr (!is_relocatable_v<T>) {
+            mover = &Relocate<T>;
+        }
+        std::tie(base_or_mr_, cap_) = GrowOutline(base_or_mr_, size_, cap_, sizeof(T), mover, newcap, G);
+    }
 
+    // Constant evaluation can't reach GrowOutline, so there the buffers come from std::allocator<T>,
+    // without a header and sized by the policy's factor but not its rounding. They can't outlive
+    // the evaluation, so they never meet the runtime paths.
+    template <typename T, GrowthPolicy G>
+    constexpr void GrowConstant(uint32_t newcap) noexcept {
+        uint64_t n = cap_ == 0 ? 1 : std::max<uint64_t>(cap_ + 1, uint64_t{cap_} * G.numerator / G.denominator);
+        auto cap = static_cast<uint32_t>(std::min<uint64_t>(std::max<uint64_t>(n, newcap), UINT32_MAX));
+        auto p = std::allocator<T>().allocate(cap);
+        if (cap_ != 0) {
+            auto old = Base<T>();
+            for (uint32_t i = 0; i < size_; i++) {
+                std::construct_at(p + i, std::move(old[i]));
+                std::destroy_at(old + i);
+            }
+            Free<T>();
+        }
+        base_or_mr_ = p;
+        cap_ = cap;
+    }
+
+    // Inline buffers have a fixed capacity and are left alone.
     template <typename T>
-    void Grow(uint32_t newcap = 0) noexcept {
+    void Shrink(uint32_t newcap) noexcept {
+        newcap = std::max(newcap, size_);
+        if (newcap < cap_ && !IsInline()) {
+            Relocator mover = nullptr;
+            if constexpr (!is_relocatable_v<T>) {
+                mover = &Relocate<T>;
+            }
+            std::tie(base_or_mr_, cap_) = ReallocOutline(base_or_mr_, size_, cap_, sizeof(T), mover, newcap);
+        }
+    }
+
+    // Moves the elements of an inline buffer to a heap buffer of the same capacity.
+    template <typename T>
+    void LeaveInline() noexcept {
         Relocator mover = nullptr;
         if constexpr (!is_relocatable_v<T>) {
             mover = &Relocate<T>;
         }
-        std::tie(base_or_mr_, cap_) = GrowOutline(base_or_mr_, size_, cap_, sizeof(T), mover, newcap);
+        std::tie(base_or_mr_, cap_) = ReallocOutline(base_or_mr_, size_, cap_, sizeof(T), mover, cap_);
     }
 
 private:
-    static std::pair<void*, uint32_t> GrowOutline(void* base, uint32_t size, uint32_t cap, uint32_t elem_size, Relocator relocate, uint32_t newcap) noexcept;
+    // Shares the outlined paths while keeping size and capacity in the buffer header.
+    template <typename T, GrowthPolicy G>
+    friend class CompactVec;
+    // Drops relocated elements from its chunks without destroying them.
+    template <IsNoThrowMoveConstructible T>
+    friend class SegVec;
+    // Allocates the bigger buffer through GrowOutline but migrates into it lazily.
+    template <IsNoThrowMoveConstructible T, uint32_t K, GrowthPolicy G>
+    friend class IncrementalVec;
+    // Allocates through GrowOutline but lays the buffer out as columns.
+    friend class SoABase;
+    // Holds the members in locals while appending.
+    template <IsNoThrowMoveConstructible T, GrowthPolicy G>
+    friend class VecBuilder;
+
+    static std::pair<void*, uint32_t> GrowOutline(void* base, uint32_t size, uint32_t cap, uint32_t elem_size, Relocator relocate, uint32_t newcap, GrowthPolicy policy) noexcept;
+    // Moves the buffer into one of exactly newcap >= size elements, a newcap of 0 frees it.
+    static std::pair<void*, uint32_t> ReallocOutline(void* base, uint32_t size, uint32_t cap, uint32_t elem_size, Relocator relocate, uint32_t newcap) noexcept;
     static void FreeOutline(void* base, size_t bytes) noexcept;
+    // Allocates exactly size elements from mr (nullptr for the default) and copies base into
+    // them, with memcpy if copy is nullptr.
+    static std::pair<void*, uint32_t> CopyOutline(const void* base, uint32_t size, uint32_t elem_size, Copier copy, MemResource* mr) noexcept;
 
     // If cap_ is 0 it's a memory resource otherwise it's pointing to base of buffer
     void* base_or_mr_ = nullptr;
@@ -157,28 +534,112 @@ private:
     uint32_t cap_ = 0;
 };
 
-template <typename T>
-concept IsNoThrowMoveConstructible = std::is_nothrow_move_constructible_v<T>;
+template <IsNoThrowMoveConstructible T, GrowthPolicy G>
+class AppendWriter;
 
-template <IsNoThrowMoveConstructible T>
+template <IsNoThrowMoveConstructible T, GrowthPolicy G = GrowthPolicy{}>
 struct Vec : public VecBase {
+    static_assert(G.denominator != 0 && G.numerator >= G.denominator);
+
     constexpr Vec() noexcept = default;
-    ~Vec() noexcept {
+    explicit constexpr Vec(MemResource* mr) noexcept : VecBase(mr) {}
+    ___constexpr ~Vec() noexcept {
+#ifdef GERBEN_VEC_STATS
+        if (!std::is_constant_evaluated()) NoteLiveBytes<T>();
+#endif
         clear();
         Free<T>();
     }
 
-    constexpr Vec(Vec&&) noexcept = default;
-    constexpr Vec& operator=(Vec&& other) noexcept = default;
+    constexpr Vec(Vec&& other) noexcept { Swap(other); }
+    constexpr Vec& operator=(Vec&& other) noexcept {
+        Swap(other);
+        return *this;
+    }
+    // Moves out of a SmallVec, whose buffer may be inline.
+    template <typename D>
+        requires(!std::is_lvalue_reference_v<D> && has_inline_buffer_v<std::remove_cvref_t<D>>)
+    Vec(D&& other) noexcept {
+        MoveAny<T>(other);
+    }
+    template <typename D>
+        requires(!std::is_lvalue_reference_v<D> && has_inline_buffer_v<std::remove_cvref_t<D>>)
+    Vec& operator=(D&& other) noexcept {
+        MoveAny<T>(other);
+        return *this;
+    }
+    // Better matches than the base class conversion, see is_pinned_vec_v.
+    template <typename D>
+        requires(!std::is_lvalue_reference_v<D> && is_pinned_vec_v<std::remove_cvref_t<D>>)
+    Vec(D&&) = delete;
+    template <typename D>
+        requires(!std::is_lvalue_reference_v<D> && is_pinned_vec_v<std::remove_cvref_t<D>>)
+    Vec& operator=(D&&) = delete;
+
+    // Takes ownership of a buffer laid out as described at kVecHeaderSize, holding size
+    // constructed elements and room for cap > 0, allocated from mr (nullptr for the default).
+    // Writes the header, so the block only needs the room for it. The current contents are
+    // destroyed and freed first.
+    void adopt(T* ptr, uint32_t size, uint32_t cap, MemResource* mr) noexcept {
+        clear();
+        Free<T>();
+        Header(ptr) = reinterpret_cast<uintptr_t>(mr ? mr : DefaultResource());
+#ifdef GERBEN_VEC_STATS
+        StatsHeader(ptr) = {};
+#endif
+        SetBuffer(ptr, size, cap);
+    }
+
+    // Gives up the buffer without destroying or freeing anything and returns its first element,
+    // or nullptr if there's no buffer. Read size() and capacity() first. The elements are the
+    // caller's to destroy, and the buffer can go back with DeallocateVecBuffer or to another Vec
+    // with adopt. An inline SmallVec buffer is copied to the heap first. The vector is left empty
+    // on the same resource.
+    T* release() noexcept {
+        if (capacity() == 0) return nullptr;
+        if (IsInline()) LeaveInline<T>();
+        auto p = data();
+        SetBuffer(Resource(), 0, 0);
+        return p;
+    }
+
+    // Copies allocate exactly other.size() elements through the outlined CopyOutline, from the
+    // source resource's copy_resource() unless given another one, so copies of an Arena backed
+    // vector must not outlive the Arena either. Assignment keeps the resource of *this and
+    // reuses its buffer when it is big enough.
+    Vec(const Vec& other) noexcept requires std::is_copy_constructible_v<T> : Vec(other, other.CopyResource()) {}
+    Vec(const Vec& other, MemResource* mr) noexcept requires std::is_copy_constructible_v<T> : VecBase(mr) {
+        CopyFrom<T>(other.data(), other.size(), mr);
+    }
+    Vec& operator=(const Vec& other) noexcept requires std::is_copy_constructible_v<T> {
+        if (this == &other) return *this;
+        clear();
+        auto n = other.size();
+        if (n <= capacity()) {
+            if (n != 0) {
+                if constexpr (std::is_trivially_copyable_v<T>) {
+                    std::memcpy(static_cast<void*>(data()), other.data(), size_t{n} * sizeof(T));
+                } else {
+                    Copy<T>(data(), other.data(), n);
+                }
+            }
+            SetSize(n);
+        } else {
+            auto mr = Resource();
+            Free<T>();
+            CopyFrom<T>(other.data(), n, mr);
+        }
+        return *this;
+    }
 
     template <typename U>
-    Vec(const std::initializer_list<U>& list) {
+    ___constexpr Vec(const std::initializer_list<U>& list) {
         reserve(list.size());
         for (auto& x : list) AddAlreadyReserved<T>(x);
     }
 
     template <typename U>
-    Vec(uint32_t n, U x) { 
+    ___constexpr Vec(uint32_t n, U x) { 
         reserve(n);
         for (uint32_t i = 0; i < n; i++) AddAlreadyReserved<T>(x);
     }
@@ -202,22 +663,27 @@ struct Vec : public VecBase {
     constexpr auto crend() const noexcept  { return rend; }
 
 
-    void reserve(uint32_t newcap) noexcept { return Reserve<T>(newcap); }
+    ___constexpr void reserve(uint32_t newcap) noexcept { return Reserve<T, G>(newcap); }
 
-    void push_back(const T& x) noexcept { Add<T>(x); }
-    void push_back(T&& x) noexcept { Add<T>(std::move(x)); }
+    ___constexpr void push_back(const T& x) noexcept { Add<T, G>(x); }
+    ___constexpr void push_back(T&& x) noexcept { Add<T, G>(std::move(x)); }
 
-    T pop_back() noexcept { return Remove<T>(); }
+    ___constexpr T pop_back() noexcept { return Remove<T>(); }
 
-    void clear() noexcept { for (auto& x : *this) x.~T(); SetSize(0); }
-    void swap(Vec& other) noexcept { Swap(other); }
-    void resize(uint32_t s) noexcept {
+    ___constexpr void clear() noexcept { for (auto& x : *this) x.~T(); SetSize(0); }
+    constexpr void swap(Vec& other) noexcept { Swap(other); }
+    template <typename D>
+        requires has_inline_buffer_v<D>
+    void swap(D& other) noexcept {
+        SwapAny(other);
+    }
+    ___constexpr void resize(uint32_t s) noexcept {
         if (s <= size()) {
             for (auto& x : Postfix(s)) x.~T();            
         } else {
             reserve(s);
             auto p = data();
-            for (uint32_t i = size(); i < s; i++) new (p + i) T();
+            for (uint32_t i = size(); i < s; i++) std::construct_at(p + i);
         }
         SetSize(s);
     }
@@ -239,32 +705,104 @@ struct Vec : public VecBase {
         SetSize(s);
     }
 
+    // Grows without initializing the new elements, for buffers that are about to be overwritten.
+    void resize_uninitialized(uint32_t s) noexcept
+        requires(std::is_trivially_default_constructible_v<T> && std::is_trivially_destructible_v<T>) {
+        reserve(s);
+        SetSize(s);
+    }
+
+    // Reserves room for n more elements and hands the uninitialized tail to fill(T* dst), e.g. to
+    // read() straight into the buffer. fill constructs the first k <= n elements and returns k, a
+    // void fill is taken to construct all n. Returns the number of elements appended.
+    template <typename F>
+    uint32_t append_with(uint32_t n, F&& fill) noexcept {
+        auto s = size();
+        // As in AppendWriter, a wrapped s + n would reserve less than fill writes.
+        if (n > UINT32_MAX - s) [[unlikely]] std::abort();
+        reserve(s + n);
+        uint32_t k = n;
+        if constexpr (std::is_void_v<std::invoke_result_t<F&, T*>>) {
+            fill(data() + s);
+        } else {
+            k = static_cast<uint32_t>(fill(data() + s));
+        }
+        SetSize(s + k);
+        return k;
+    }
+
     template <typename It>
     void assign(It first, It last) noexcept {
-        uint32_t idx = 0;
-        for (auto &x : *this) {
-            if (first == last) {
-                resize(idx);
-                return;
+        if constexpr (std::is_trivially_copyable_v<T> && std::forward_iterator<It>) {
+            clear();
+            append_range(std::ranges::subrange(first, last));
+        } else {
+            uint32_t idx = 0;
+            for (auto &x : *this) {
+                if (first == last) {
+                    resize(idx);
+                    return;
+                }
+                x = *first;
+                ++first; ++idx;
             }
-            x = *first;
-            ++first; ++idx;
+            append_range(std::ranges::subrange(first, last));
+        }
+    }
+
+    // The appended or inserted range must not alias *this. Sized and forward ranges reserve once
+    // and are copied with a single memcpy when T is trivially copyable.
+    ___constexpr void append(std::span<const T> xs) noexcept { append_range(xs); }
+
+    template <std::ranges::input_range R>
+    ___constexpr void append_range(R&& r) noexcept {
+        if constexpr (std::ranges::forward_range<R> || std::ranges::sized_range<R>) {
+            auto n = static_cast<uint32_t>(std::ranges::distance(r));
+            auto s = size();
+            if (n > UINT32_MAX - s) [[unlikely]] std::abort();
+            reserve(s + n);
+            ConstructN(data() + s, std::ranges::begin(r), n);
+            SetSize(s + n);
+        } else {
+            for (auto&& x : r) emplace_back(std::forward<decltype(x)>(x));
+        }
+    }
+
+    template <std::ranges::input_range R>
+    T* insert_range(T* position, R&& r) noexcept {
+        auto i = static_cast<uint32_t>(position - data());
+        if constexpr (std::ranges::forward_range<R> || std::ranges::sized_range<R>) {
+            auto n = static_cast<uint32_t>(std::ranges::distance(r));
+            auto s = size();
+            ConstructN(OpenGap<T, G>(i, n), std::ranges::begin(r), n);
+            SetSize(s + n);
+        } else {
+            // Single pass, so collect the range first to learn its size.
+            Vec tmp;
+            tmp.append_range(std::forward<R>(r));
+            auto n = tmp.size();
+            auto s = size();
+            RelocateN(OpenGap<T, G>(i, n), tmp.data(), n);
+            tmp.SetSize(0);
+            SetSize(s + n);
         }
-        for (; first != last; ++first) push_back(*first);
+        return data() + i;
     }
     // At is specified to throw
-    auto at(uint32_t idx) { if (idx >= size()) ThrowOutOfRange(); return Get(idx); }
-    auto at(uint32_t idx) const { if (idx >= size()) ThrowOutOfRange(); return Get(idx); }
+    T& at(uint32_t idx) { if (idx >= size()) ThrowOutOfRange(); return Get(idx); }
+    T const& at(uint32_t idx) const { if (idx >= size()) ThrowOutOfRange(); return Get(idx); }
 
-    T& operator[](uint32_t idx) noexcept { return data()[idx]; }
-    T const& operator[](uint32_t idx) const noexcept { return data()[idx]; }
+    constexpr T& operator[](uint32_t idx) noexcept { return data()[idx]; }
+    constexpr T const& operator[](uint32_t idx) const noexcept { return data()[idx]; }
 
-    auto front() noexcept { return Get(0); }
-    auto front() const noexcept { return Get(0); }
-    auto back() noexcept { return Get(size() - 1); }
-    auto back() const noexcept { return Get(size() - 1); }
+    constexpr T& front() noexcept { return Get(0); }
+    constexpr T const& front() const noexcept { return Get(0); }
+    constexpr T& back() noexcept { return Get(size() - 1); }
+    constexpr T const& back() const noexcept { return Get(size() - 1); }
 
-    void shrink_to_fit(uint32_t) noexcept {}
+    void shrink_to_fit() noexcept { Shrink<T>(size()); }
+    // Reduces capacity to max(newcap, size()), never grows.
+    void shrink_to(uint32_t newcap) noexcept { Shrink<T>(newcap); }
 
     T* erase(T* first) noexcept {
         return erase(first, first + 1);
@@ -275,57 +813,212 @@ struct Vec : public VecBase {
         auto ret = first;
         if (d == 0) return first;
         auto e = end();
-        while (last != e) {
-            *first = std::move(*last);
-            ++first; ++last;
-        }
-        while (first != e) {
-            first->~T();
-            ++first;
+        if constexpr (is_relocatable_v<T>) {
+            std::destroy(first, last);
+            std::memmove(static_cast<void*>(first), last, (e - last) * sizeof(T));
+        } else {
+            while (last != e) {
+                *first = std::move(*last);
+                ++first; ++last;
+            }
+            while (first != e) {
+                first->~T();
+                ++first;
+            }
         }
         SetSize(size() - d);
         return ret;
     }
-    void insert(T* position, T res) noexcept {
-        auto i = position - data();
+    // Removes the elements for which pred holds in one pass, keeping the order of the rest, and
+    // returns how many were removed. Survivors are relocated bitwise when T allows it. For
+    // trivially copyable T a predicate with a `uint32_t Compact(T*, uint32_t)` member, like
+    // simd::Compare, does the whole compaction itself.
+    template <typename Pred>
+    uint32_t erase_if(Pred pred) noexcept {
+        auto n = size();
+        auto p = data();
+        uint32_t k = 0;
+        if constexpr (std::is_trivially_copyable_v<T> &&
+                      requires { { pred.Compact(p, n) } -> std::convertible_to<uint32_t>; }) {
+            k = pred.Compact(p, n);
+        } else {
+            while (k < n && !pred(std::as_const(p[k]))) k++;
+            // p[k] is the first match, don't ask pred about it twice.
+            if constexpr (is_relocatable_v<T>) {
+                if (k < n) p[k].~T();
+            }
+            for (uint32_t i = k + 1; i < n; i++) {
+                if (pred(std::as_const(p[i]))) {
+                    if constexpr (is_relocatable_v<T>) p[i].~T();
+                } else if constexpr (is_relocatable_v<T>) {
+                    std::memcpy(static_cast<void*>(p + k++), p + i, sizeof(T));
+                } else {
+                    p[k++] = std::move(p[i]);
+                }
+            }
+            // Past k are the removed elements and the moved-from survivors.
+            if constexpr (!is_relocatable_v<T>) std::destroy(p + k, p + n);
+        }
+        SetSize(k);
+        return n - k;
+    }
+    // Keeps the elements for which pred holds, the complement of erase_if.
+    template <typename Pred>
+    void retain(Pred pred) noexcept {
+        erase_if([&pred](const T& x) { return !pred(x); });
+    }
+    T* insert(T* position, T res) noexcept {
+        auto i = static_cast<uint32_t>(position - data());
         auto s = size();
-        push_back(std::move(res));
-        std::rotate(data() + i, data() + s, data() + size());
+        new (OpenGap<T, G>(i, 1)) T(std::move(res));
+        SetSize(s + 1);
+        return data() + i;
     }
-    void insert(T* position, uint32_t n, const T& res) noexcept {
-        auto i = position - data();
+    T* insert(T* position, uint32_t n, const T& res) noexcept {
+        auto i = static_cast<uint32_t>(position - data());
         auto s = size();
-        reserve(n + s);
-        while (n--) AddAlreadyReserved<T>(res);
-        std::rotate(data() + i, data() + s, data() + size());
+        T x = res;  // res may live in the buffer that OpenGap moves
+        auto gap = OpenGap<T, G>(i, n);
+        for (uint32_t j = 0; j < n; j++) new (gap + j) T(x);
+        SetSize(s + n);
+        return data() + i;
     }
-    template <class InputIterator>
+    template <std::input_iterator InputIterator>
     void insert(T* position, InputIterator first, InputIterator last) noexcept {
-        auto s = size();
-        auto i = position - data();
-        while (first != last) { push_back(*first); ++first; }
-        std::rotate(data() + i, data() + s, data() + size());
+        insert_range(position, std::ranges::subrange(first, last));
     }
     template <typename... Args>
-    void emplace(T* position, Args&&... args) noexcept {
-        insert(position, T(std::forward<Args>(args)...));
+    T* emplace(T* position, Args&&... args) noexcept {
+        return insert(position, T(std::forward<Args>(args)...));
     }
     template <typename... Args>
-    void emplace_back(Args&&... args) noexcept {
-        push_back(T(std::forward<Args>(args)...));
+    ___constexpr T& emplace_back(Args&&... args) noexcept {
+        return AddEmplace<T, G>(std::forward<Args>(args)...);
     }
 
-    T& Get(uint32_t idx) noexcept { return data()[idx]; }
-    T const& Get(uint32_t idx) const noexcept { return data()[idx]; }
+    // Reserves room for n more elements and returns a writer that appends them without
+    // capacity checks, see AppendWriter.
+    AppendWriter<T, G> back_inserter_reserved(uint32_t n) noexcept { return AppendWriter<T, G>(this, n); }
+
+    constexpr T& Get(uint32_t idx) noexcept { return data()[idx]; }
+    constexpr T const& Get(uint32_t idx) const noexcept { return data()[idx]; }
+
+    constexpr std::span<T> Prefix(uint32_t idx) { return {data(), idx}; }
+    constexpr std::span<T const> Prefix(uint32_t idx) const { return {data(), idx}; }
+    constexpr std::span<T> Postfix(uint32_t idx) { return {data() + idx, size() - idx}; }
+    constexpr std::span<T const> Postfix(uint32_t idx) const { return {data() + idx, size() - idx}; }
+
+protected:
+    // Swaps by three moves that each check for inline buffers.
+    void SwapAny(Vec& other) noexcept {
+        Vec tmp;
+        tmp.template MoveAny<T>(other);
+        other.template MoveAny<T>(*this);
+        this->template MoveAny<T>(tmp);
+    }
 
-    std::span<T> Prefix(uint32_t idx) { return {data(), idx}; }
-    std::span<T const> Prefix(uint32_t idx) const { return {data(), idx}; }
-    std::span<T> Postfix(uint32_t idx) { return {data() + idx, size() - idx}; }
-    std::span<T const> Postfix(uint32_t idx) const { return {data() + idx, size() - idx}; }
+    friend class AppendWriter<T, G>;
 };
 
-template <typename T>
-inline constexpr bool is_known_relocatable_v<Vec<T>> = true;
+template <typename T, GrowthPolicy G>
+inline constexpr bool is_known_relocatable_v<Vec<T, G>> = true;
+
+// Appends a burst of at most n elements, n given up front. The constructor reserves once, after
+// which the elements are written through a local cursor with no capacity check and the vector
+// isn't touched until the destructor commits the new size, so a fill loop compiles to plain
+// stores the compiler can vectorize. Writing more than n elements, or using the vector while the
+// writer lives, is undefined.
+//
+//   auto w = v.back_inserter_reserved(n);
+//   for (uint32_t i = 0; i < n; i++) w.push_back(f(i));
+template <IsNoThrowMoveConstructible T, GrowthPolicy G>
+class AppendWriter {
+public:
+    AppendWriter(Vec<T, G>* vec, uint32_t n) noexcept : vec_(vec) {
+        // A wrapped size would reserve less than the unchecked stores write, so like running out
+        // of memory this aborts.
+        if (n > UINT32_MAX - vec->size()) [[unlikely]] std::abort();
+        vec->reserve(vec->size() + n);
+        cursor_ = vec->data() + vec->size();
+    }
+    ~AppendWriter() noexcept { vec_->SetSize(static_cast<uint32_t>(cursor_ - vec_->data())); }
+    AppendWriter(const AppendWriter&) = delete;
+    AppendWriter& operator=(const AppendWriter&) = delete;
+
+    void push_back(const T& x) noexcept { new (cursor_++) T(x); }
+    void push_back(T&& x) noexcept { new (cursor_++) T(std::move(x)); }
+    template <typename... Args>
+    T& emplace_back(Args&&... args) noexcept {
+        return *new (cursor_++) T(std::forward<Args>(args)...);
+    }
+
+    // The next uninitialized slot. After constructing k elements through it, call advance(k).
+    T* cursor() const noexcept { return cursor_; }
+    void advance(uint32_t k) noexcept { cursor_ += k; }
+
+private:
+    Vec<T, G>* const vec_;
+    T* cursor_;
+};
+
+// Vec with room for N elements inside the object, the heap is only touched once it outgrows them.
+// The inline buffer mimics a heap buffer including its header, so growing goes through the same
+// outlined GrowOutline and the push_back fast path is identical to Vec.
+template <typename T, uint32_t N, GrowthPolicy G = GrowthPolicy{}>
+class SmallVec : public Vec<T, G> {
+    static_assert(N > 0);
+    static_assert(alignof(T) <= alignof(std::max_align_t));
+public:
+    SmallVec() noexcept { this->SetInline(Inline(), N, nullptr); }
+    explicit SmallVec(MemResource* mr) noexcept { this->SetInline(Inline(), N, mr); }
+    ~SmallVec() noexcept {
+#ifdef GERBEN_VEC_STATS
+        this->template NoteLiveBytes<T>();
+#endif
+        this->clear();
+        this->DetachInline();
+    }
+
+    SmallVec(SmallVec&& other) noexcept : SmallVec() { *this = std::move(other); }
+    SmallVec& operator=(SmallVec&& other) noexcept {
+        Vec<T, G>::operator=(std::move(other));
+        other.ReattachInline();
+        return *this;
+    }
+
+    // Copies that fit stay inline.
+    SmallVec(const SmallVec& other) noexcept requires std::is_copy_constructible_v<T>
+        : SmallVec(other.CopyResource()) {
+        *this = other;
+    }
+    SmallVec& operator=(const SmallVec& other) noexcept requires std::is_copy_constructible_v<T> {
+        Vec<T, G>::operator=(other);
+        return *this;
+    }
+
+    void swap(Vec<T, G>& other) noexcept { this->SwapAny(other); }
+
+    template <typename U>
+    SmallVec(const std::initializer_list<U>& list) : SmallVec() {
+        this->reserve(list.size());
+        for (auto& x : list) this->push_back(x);
+    }
+
+private:
+    // Only the last word of the header is used, so reserve just enough to keep T aligned.
+    static constexpr size_t kHeaderSize = std::max(alignof(T), sizeof(uintptr_t));
+
+    void* Inline() noexcept { return storage_ + kHeaderSize; }
+    // Moving out our heap buffer leaves us without one, fall back on the inline buffer.
+    void ReattachInline() noexcept {
+        if (this->capacity() == 0) this->SetInline(Inline(), N, this->Resource());
+    }
+
+    alignas(kHeaderSize) std::byte storage_[kHeaderSize + N * sizeof(T)];
+};
+
+template <typename T, uint32_t N, GrowthPolicy G>
+inline constexpr bool has_inline_buffer_v<SmallVec<T, N, G>> = true;
 
 template <typename T>
 class LocalCapture : public T {
@@ -0,0 +1,155 @@
+#include "vector.hpp"
+#include "mapped_vec.hpp"
+#include "vec_builder.hpp"
+
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <optional>
+#include <string>
+#include <type_traits>
+
+#include "gtest/gtest.h"
+
+namespace gerben {
+namespace {
+
+TEST(EraseIf, CallsPredicateOncePerElement) {
+    Vec<int> v;
+    for (int i = 0; i < 10; i++) v.push_back(i);
+    int calls = 0;
+    EXPECT_EQ(v.erase_if([&calls](int x) {
+        calls++;
+        return x % 3 == 1;
+    }), 3u);
+    EXPECT_EQ(calls, 10);
+    EXPECT_EQ(v.size(), 7u);
+    EXPECT_EQ(v[0], 0);
+    EXPECT_EQ(v[1], 2);
+    EXPECT_EQ(v[6], 9);
+}
+
+// A stateful predicate sees every element once and in order.
+TEST(EraseIf, RemovesFirstN) {
+    Vec<std::string> v;
+    for (int i = 0; i < 8; i++) v.push_back(std::to_string(i));
+    int left = 3;
+    EXPECT_EQ(v.erase_if([&left](const std::string&) { return left-- > 0; }), 3u);
+    ASSERT_EQ(v.size(), 5u);
+    EXPECT_EQ(v[0], "3");
+    EXPECT_EQ(v[4], "7");
+}
+
+TEST(EraseIf, NonRelocatable) {
+    struct SelfRef {
+        explicit SelfRef(int x) noexcept : self(this), value(x) {}
+        SelfRef(SelfRef&& other) noexcept : self(this), value(other.value) {}
+        SelfRef& operator=(SelfRef&& other) noexcept {
+            value = other.value;
+            return *this;
+        }
+        SelfRef* self;
+        int value;
+    };
+    Vec<SelfRef> v;
+    for (int i = 0; i < 10; i++) v.emplace_back(i);
+    int calls = 0;
+    EXPECT_EQ(v.erase_if([&calls](const SelfRef& x) {
+        calls++;
+        return x.value < 2 || x.value == 5;
+    }), 3u);
+    EXPECT_EQ(calls, 10);
+    ASSERT_EQ(v.size(), 7u);
+    for (auto& x : v) EXPECT_EQ(x.self, &x);
+    EXPECT_EQ(v[0].value, 2);
+    EXPECT_EQ(v[3].value, 6);
+}
+
+// Moving would leave the Vec pointing at the MappedVec's mapping, copying reads it into the heap.
+static_assert(!std::is_constructible_v<Vec<int>, MappedVec<int>&&>);
+static_assert(!std::is_assignable_v<Vec<int>&, MappedVec<int>&&>);
+static_assert(!std::is_move_constructible_v<MappedVec<int>>);
+static_assert(std::is_constructible_v<Vec<int>, const MappedVec<int>&>);
+static_assert(std::is_constructible_v<Vec<int>, Vec<int>&&>);
+
+Vec<std::string> Strings(int n) {
+    Vec<std::string> v;
+    for (int i = 0; i < n; i++) v.push_back(std::to_string(i));
+    return v;
+}
+
+// Moves and swaps with a SmallVec on either side, with the buffer inline or on the heap.
+TEST(SmallVec, MovesAndSwapsWithVec) {
+    for (int n : {0, 2, 20}) {
+        SmallVec<std::string, 4> small;
+        small.append(Strings(n));
+        Vec<std::string> v(std::move(small));
+        ASSERT_EQ(v.size(), uint32_t(n));
+        if (n) {
+            EXPECT_EQ(v.back(), std::to_string(n - 1));
+        }
+        small = SmallVec<std::string, 4>();
+        small.push_back("x");
+        v = std::move(small);
+        ASSERT_EQ(v.size(), 1u);
+        EXPECT_EQ(v[0], "x");
+
+        for (int m : {0, 3, 30}) {
+            SmallVec<std::string, 4> a;
+            a.append(Strings(n));
+            auto b = Strings(m);
+            b.swap(a);
+            EXPECT_EQ(a.size(), uint32_t(m));
+            EXPECT_EQ(b.size(), uint32_t(n));
+            a.swap(b);
+            EXPECT_EQ(a.size(), uint32_t(n));
+            EXPECT_EQ(b.size(), uint32_t(m));
+            if (n) {
+                EXPECT_EQ(a.back(), std::to_string(n - 1));
+            }
+            if (m) {
+                EXPECT_EQ(b.back(), std::to_string(m - 1));
+            }
+            a.push_back("y");
+            b.push_back("z");
+        }
+    }
+}
+
+std::string TempPath(const char* name) {
+    auto dir = std::getenv("TEST_TMPDIR");
+    return std::string(dir ? dir : "/tmp") + "/" + name;
+}
+
+// The copy must not keep the MappedFile as its resource, ~Vec would call into it after it's gone.
+TEST(Copy, OutlivesMappedVec) {
+    auto path = TempPath("copy_outlives_mapped_vec");
+    Vec<int> src;
+    for (int i = 0; i < 1000; i++) src.push_back(i);
+    ASSERT_TRUE(SaveVec<int>(path.c_str(), src));
+    std::optional<Vec<int>> copy;
+    {
+        MappedVec<int> mapped;
+        ASSERT_TRUE(mapped.Open(path.c_str()));
+        const Vec<int>& base = mapped;
+        copy.emplace(base);
+    }
+    ASSERT_EQ(copy->size(), 1000u);
+    EXPECT_EQ((*copy)[999], 999);
+    copy->push_back(1000);
+    copy.reset();
+}
+
+// s + n wrapping past UINT32_MAX would reserve a tiny buffer and let fill write past it.
+TEST(AppendWithDeathTest, AbortsOnSizeOverflow) {
+    Vec<char> v;
+    v.push_back('a');
+    EXPECT_DEATH(v.append_with(UINT32_MAX, [](char*) {}), "");
+    EXPECT_DEATH({
+        VecBuilder<char> b(&v);
+        b.append_with(UINT32_MAX, [](char*) {});
+    }, "");
+}
+
+}  // namespace
+}  // namespace gerben